@@ -0,0 +1,165 @@
+#include <iostream>
+#include <mt-bridge.hpp>
+#include <mt-bridge-feeder.hpp>
+#include <random>
+#include <thread>
+#include <chrono>
+
+/* замер кадров DELTA против полных кадров SNAPSHOT:
+ * сколько байтов в секунду передает советник и сколько времени
+ * занимает декодирование кадра
+ */
+
+/* имитация рынка: за один период обновления меняется только часть символов */
+class Market {
+public:
+    std::vector<mt_bridge::MtSymbolRecord> records;
+    std::mt19937 gen;
+    double changed_ratio;
+    uint64_t server_timestamp = 1600000000;
+
+    Market(const uint32_t num_symbol, const double ratio) :
+            records(num_symbol), gen(1), changed_ratio(ratio) {
+        for(uint32_t s = 0; s < num_symbol; ++s) {
+            mt_bridge::MtSymbolRecord &r = records[s];
+            r.bid = 1.0 + s * 0.1;
+            r.ask = r.bid + 1e-4;
+            r.open = r.high = r.low = r.close = r.bid;
+            r.volume = 1;
+            r.timestamp = (server_timestamp / 60) * 60;
+        }
+    }
+
+    /* шаг имитации, period_ms - период обновления советника */
+    void step(const uint32_t period_ms) {
+        std::uniform_real_distribution<double> ratio(0.0, 1.0);
+        std::uniform_int_distribution<int> move(-3, 3);
+        server_timestamp += ((gen() % 1000) < period_ms) ? 1 : 0;
+        const uint64_t bar_timestamp = (server_timestamp / 60) * 60;
+        for(size_t s = 0; s < records.size(); ++s) {
+            mt_bridge::MtSymbolRecord &r = records[s];
+            if(r.timestamp != bar_timestamp) {
+                r.timestamp = bar_timestamp;
+                r.open = r.high = r.low = r.close;
+                r.volume = 0;
+            }
+            if(ratio(gen) >= changed_ratio) continue;
+            r.bid += move(gen) * 1e-5;
+            r.ask = r.bid + 1e-4;
+            r.close = r.bid;
+            r.high = std::max(r.high, r.bid);
+            r.low = std::min(r.low, r.bid);
+            ++r.volume;
+        }
+    }
+};
+
+/* передаем кадры в мост и считаем байты */
+void run_bridge(const std::string &name, const bool is_delta, const uint32_t num_symbol,
+        const uint32_t num_frames, const uint32_t period_ms, const double ratio) {
+    const uint32_t port = 5570 + (is_delta ? 1 : 0);
+    mt_bridge::MtBridge bridge(port);
+    std::vector<std::string> symbols;
+    for(uint32_t s = 0; s < num_symbol; ++s) symbols.push_back("SYM" + std::to_string(s));
+
+    Market market(num_symbol, ratio);
+    mt_bridge::MtFeeder feeder("127.0.0.1", port);
+    feeder.send_handshake(symbols, 0, 2);
+    feeder.send_frame(market.records, market.server_timestamp);
+    const uint64_t handshake_bytes = feeder.get_bytes_sent();
+    for(uint32_t f = 0; f < num_frames; ++f) {
+        market.step(period_ms);
+        if(is_delta) feeder.send_delta_frame(market.records, market.server_timestamp);
+        else feeder.send_frame(market.records, market.server_timestamp);
+    }
+    const uint64_t bytes = feeder.get_bytes_sent() - handshake_bytes;
+
+    /* ждем, пока мост прочитает последний кадр, и сверяем цены */
+    const mt_bridge::MtSymbolRecord &last = market.records[num_symbol - 1];
+    const auto start = std::chrono::steady_clock::now();
+    while(bridge.get_bid(num_symbol - 1) != last.bid &&
+        std::chrono::steady_clock::now() - start < std::chrono::seconds(5)) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    uint32_t mismatch = 0;
+    for(uint32_t s = 0; s < num_symbol; ++s) {
+        if(bridge.get_bid(s) != market.records[s].bid) ++mismatch;
+        if(bridge.get_candle(s).close != market.records[s].close) ++mismatch;
+    }
+    feeder.close();
+
+    const double frames_per_second = 1000.0 / (double)period_ms;
+    std::cout << name
+        << " bytes/frame: " << ((double)bytes / (double)num_frames)
+        << " bytes/s at " << period_ms << " ms: "
+        << ((double)bytes / (double)num_frames * frames_per_second)
+        << " mismatch: " << mismatch
+        << std::endl;
+}
+
+/* замер времени декодирования без сокета */
+void run_decode(const uint32_t num_symbol, const uint32_t num_frames, const uint32_t period_ms, const double ratio) {
+    Market market(num_symbol, ratio);
+    std::vector<std::vector<uint8_t>> snapshot_frames(num_frames);
+    std::vector<std::vector<uint8_t>> delta_frames(num_frames);
+    std::vector<mt_bridge::MtSymbolRecord> last_records = market.records;
+    for(uint32_t f = 0; f < num_frames; ++f) {
+        market.step(period_ms);
+        mt_bridge::encode_frame(snapshot_frames[f], market.records, market.server_timestamp);
+        mt_bridge::encode_delta_frame(delta_frames[f], last_records, market.records, market.server_timestamp);
+        last_records = market.records;
+    }
+
+    double sum = 0;
+    std::vector<mt_bridge::MtSymbolRecord> records(num_symbol);
+    auto start = std::chrono::steady_clock::now();
+    for(uint32_t f = 0; f < num_frames; ++f) {
+        const uint8_t *frame = snapshot_frames[f].data();
+        for(uint32_t s = 0; s < num_symbol; ++s) {
+            mt_bridge::decode_symbol_record(frame + s * mt_bridge::MT_BRIDGE_SYMBOL_RECORD_SIZE, records[s]);
+            sum += records[s].bid;
+        }
+    }
+    const double snapshot_ns = std::chrono::duration<double, std::nano>(
+        std::chrono::steady_clock::now() - start).count() / num_frames;
+
+    Market initial(num_symbol, ratio);
+    records = initial.records;
+    std::vector<uint32_t> changed_symbols;
+    changed_symbols.reserve(num_symbol);
+    start = std::chrono::steady_clock::now();
+    for(uint32_t f = 0; f < num_frames; ++f) {
+        mt_bridge::decode_delta_frame(delta_frames[f].data(), delta_frames[f].size(), records, changed_symbols);
+        for(size_t i = 0; i < changed_symbols.size(); ++i) {
+            sum += records[changed_symbols[i]].bid;
+        }
+    }
+    const double delta_ns = std::chrono::duration<double, std::nano>(
+        std::chrono::steady_clock::now() - start).count() / num_frames;
+
+    uint32_t mismatch = 0;
+    for(uint32_t s = 0; s < num_symbol; ++s) {
+        if(std::memcmp(&records[s], &market.records[s], sizeof(mt_bridge::MtSymbolRecord)) != 0) ++mismatch;
+    }
+    std::cout << "decode snapshot: " << snapshot_ns << " ns/frame"
+        << " delta: " << delta_ns << " ns/frame"
+        << " mismatch: " << mismatch
+        << " (check " << sum << ")"
+        << std::endl;
+}
+
+int main() {
+    const uint32_t num_frames = 10000;
+    const uint32_t num_symbol = 26;
+    const uint32_t period_ms[] = {1000, 100};
+    const double ratio[] = {0.5, 0.1};
+    for(size_t i = 0; i < 2; ++i) {
+        std::cout << "symbols: " << num_symbol
+            << " period: " << period_ms[i] << " ms"
+            << " changed symbols: " << (ratio[i] * 100) << "%" << std::endl;
+        run_bridge("snapshot", false, num_symbol, num_frames, period_ms[i], ratio[i]);
+        run_bridge("delta   ", true, num_symbol, num_frames, period_ms[i], ratio[i]);
+        run_decode(num_symbol, num_frames, period_ms[i], ratio[i]);
+    }
+    return 0;
+}
@@ -0,0 +1,143 @@
+#include <iostream>
+#include <mt-bridge-buffer.hpp>
+#include <mt-bridge-feeder.hpp>
+#include <thread>
+#include <chrono>
+
+/* замер чтения кадров: старый путь (boost::asio::read на каждое поле)
+ * против буферизированного чтения кадра целиком
+ */
+
+using boost::asio::ip::tcp;
+
+/* обертка над сокетом для подсчета вызовов read_some */
+class CountingStream {
+public:
+    tcp::socket &socket;
+    size_t calls = 0;
+
+    CountingStream(tcp::socket &s) : socket(s) {};
+
+    template<class MutableBufferSequence>
+    size_t read_some(const MutableBufferSequence &buffers) {
+        ++calls;
+        return socket.read_some(buffers);
+    }
+
+    template<class MutableBufferSequence>
+    size_t read_some(const MutableBufferSequence &buffers, boost::system::error_code &ec) {
+        ++calls;
+        return socket.read_some(buffers, ec);
+    }
+};
+
+template<class T>
+T read_field(CountingStream &stream) {
+    uint8_t data[sizeof(T)];
+    boost::asio::read(stream, boost::asio::buffer(data, sizeof(T)));
+    return mt_bridge::decode_value<T>(data);
+}
+
+std::string read_name(CountingStream &stream) {
+    char data[mt_bridge::MT_BRIDGE_SYMBOL_NAME_SIZE];
+    boost::asio::read(stream, boost::asio::buffer(data, sizeof(data)));
+    return std::string(data, strnlen(data, sizeof(data)));
+}
+
+/* старый путь чтения */
+double read_per_field(CountingStream &stream, const uint32_t num_frames) {
+    double sum = 0;
+    read_field<uint32_t>(stream);
+    const uint32_t num_symbol = read_field<uint32_t>(stream);
+    for(uint32_t s = 0; s < num_symbol; ++s) read_name(stream);
+    read_field<uint32_t>(stream);
+    for(uint32_t f = 0; f < num_frames; ++f) {
+        for(uint32_t s = 0; s < num_symbol; ++s) {
+            sum += read_field<double>(stream); // bid
+            sum += read_field<double>(stream); // ask
+            sum += read_field<double>(stream); // open
+            sum += read_field<double>(stream); // high
+            sum += read_field<double>(stream); // low
+            sum += read_field<double>(stream); // close
+            sum += read_field<uint64_t>(stream); // volume
+            sum += read_field<uint64_t>(stream); // timestamp
+        }
+        sum += read_field<uint64_t>(stream);
+    }
+    return sum;
+}
+
+/* новый путь чтения */
+double read_buffered(CountingStream &stream, const uint32_t num_frames) {
+    double sum = 0;
+    mt_bridge::MtBufferedReader<CountingStream> reader(stream);
+    reader.read_uint32();
+    const uint32_t num_symbol = reader.read_uint32();
+    for(uint32_t s = 0; s < num_symbol; ++s) reader.read_string();
+    reader.read_uint32();
+    mt_bridge::MtSymbolRecord record;
+    for(uint32_t f = 0; f < num_frames; ++f) {
+        const uint8_t *frame = reader.read_frame(num_symbol);
+        for(uint32_t s = 0; s < num_symbol; ++s) {
+            mt_bridge::decode_symbol_record(frame + s * mt_bridge::MT_BRIDGE_SYMBOL_RECORD_SIZE, record);
+            sum += record.bid + record.ask + record.open + record.high +
+                record.low + record.close + record.volume + record.timestamp;
+        }
+        sum += mt_bridge::decode_value<uint64_t>(frame + num_symbol * mt_bridge::MT_BRIDGE_SYMBOL_RECORD_SIZE);
+    }
+    return sum;
+}
+
+void run(const std::string &name, const bool is_buffered, const uint32_t num_symbol, const uint32_t num_frames) {
+    boost::asio::io_context io_context;
+    tcp::acceptor acceptor(io_context, tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0));
+    const uint32_t port = acceptor.local_endpoint().port();
+
+    std::thread feeder_thread([=]() {
+        std::vector<std::string> symbols;
+        for(uint32_t s = 0; s < num_symbol; ++s) symbols.push_back("SYM" + std::to_string(s));
+        std::vector<mt_bridge::MtSymbolRecord> records(num_symbol);
+        mt_bridge::MtFeeder feeder("127.0.0.1", port);
+        feeder.send_handshake(symbols, num_frames);
+        for(uint32_t f = 0; f < num_frames; ++f) {
+            for(uint32_t s = 0; s < num_symbol; ++s) {
+                records[s].bid = 1.1 + f * 1e-5;
+                records[s].ask = records[s].bid + 1e-4;
+                records[s].open = records[s].high = records[s].low = records[s].close = records[s].bid;
+                records[s].volume = f;
+                records[s].timestamp = 1600000000 + f * 60;
+            }
+            feeder.send_frame(records, 1600000000 + f * 60);
+        }
+        feeder.close();
+    });
+
+    tcp::socket socket(io_context);
+    acceptor.accept(socket);
+    CountingStream stream(socket);
+
+    const auto start = std::chrono::steady_clock::now();
+    const double sum = is_buffered ?
+        read_buffered(stream, num_frames) :
+        read_per_field(stream, num_frames);
+    const auto stop = std::chrono::steady_clock::now();
+    feeder_thread.join();
+
+    const double ms = std::chrono::duration<double, std::milli>(stop - start).count();
+    std::cout << name
+        << " symbols: " << num_symbol
+        << " frames: " << num_frames
+        << " read calls: " << stream.calls
+        << " calls/frame: " << ((double)stream.calls / (double)num_frames)
+        << " time: " << ms << " ms"
+        << " (check " << sum << ")"
+        << std::endl;
+}
+
+int main() {
+    const uint32_t num_symbol = 26;
+    const uint32_t num_frames = 1440;
+    run("per-field", false, num_symbol, num_frames);
+    run("buffered ", true, num_symbol, num_frames);
+    return 0;
+}
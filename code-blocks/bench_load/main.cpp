@@ -0,0 +1,190 @@
+#include <iostream>
+#include <mt-bridge.hpp>
+#include <mt-bridge-feeder.hpp>
+#include <algorithm>
+#include <thread>
+#include <chrono>
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+/* нагрузочный тест моста без терминала Metatrader:
+ * генератор передает кадры протокола версии 1 для 26, 500 и 5000 символов,
+ * замеряем, сколько кадров в секунду успевает разобрать мост,
+ * сколько процессорного времени на это уходит и задержку
+ * от передачи кадра до вызова callback
+ */
+
+#if defined(_WIN32)
+inline double filetime_to_seconds(const FILETIME &t) {
+    return (double)(((uint64_t)t.dwHighDateTime << 32) | t.dwLowDateTime) / 10000000.0;
+}
+
+/* процессорное время всех потоков программы */
+double get_process_cpu_time() {
+    FILETIME creation_time, exit_time, kernel_time, user_time;
+    GetProcessTimes(GetCurrentProcess(), &creation_time, &exit_time, &kernel_time, &user_time);
+    return filetime_to_seconds(kernel_time) + filetime_to_seconds(user_time);
+}
+
+/* процессорное время текущего потока */
+double get_thread_cpu_time() {
+    FILETIME creation_time, exit_time, kernel_time, user_time;
+    GetThreadTimes(GetCurrentThread(), &creation_time, &exit_time, &kernel_time, &user_time);
+    return filetime_to_seconds(kernel_time) + filetime_to_seconds(user_time);
+}
+#else
+double get_process_cpu_time() {
+    timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+double get_thread_cpu_time() {
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+#endif
+
+typedef mt_bridge::MetatraderBridge<mt_bridge::MtCandle> Bridge;
+
+/* ждем, пока мост разберет все переданные байты */
+void wait_processed(Bridge &bridge, const uint64_t bytes) {
+    const auto start = std::chrono::steady_clock::now();
+    while(bridge.get_bytes_processed() < bytes &&
+        std::chrono::steady_clock::now() - start < std::chrono::seconds(10)) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+/* задержка этапа по метрикам моста */
+void print_stage(const std::string &name, const mt_bridge::MtLatencyStats &stats) {
+    std::cout << "    " << name << ", us:"
+        << " p50: " << stats.p50
+        << " p99: " << stats.p99
+        << " max: " << stats.max
+        << " count: " << stats.count
+        << std::endl;
+}
+
+/* пропускная способность: генератор передает кадры без пауз */
+void run_throughput(const uint32_t num_symbol, const uint32_t port, const double duration) {
+    std::atomic<uint64_t> callbacks(0);
+    Bridge::Config config(port, 10);
+    config.snapshot_callback = [&](
+            const mt_bridge::MtSnapshot<mt_bridge::MtCandle> &/*snapshot*/,
+            const Bridge::EventType /*event*/,
+            const uint64_t /*timestamp*/) {
+        ++callbacks;
+    };
+    Bridge bridge(config);
+
+    mt_bridge::MtFeedGenerator generator("127.0.0.1", port, num_symbol, 10, 1);
+    generator.time_step_ms = 1000;
+    const uint64_t start_timestamp = std::time(nullptr);
+    generator.start(start_timestamp);
+    bridge.wait();
+    wait_processed(bridge, generator.get_bytes_sent());
+
+    const uint64_t start_bytes = generator.get_bytes_sent();
+    const double start_process_cpu = get_process_cpu_time();
+    const double start_thread_cpu = get_thread_cpu_time();
+    const auto start = std::chrono::steady_clock::now();
+    uint64_t frames = 0;
+    while(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() < duration) {
+        generator.send(start_timestamp + (++frames));
+    }
+    const double generator_cpu = get_thread_cpu_time() - start_thread_cpu;
+    wait_processed(bridge, generator.get_bytes_sent());
+    const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    const double bridge_cpu = get_process_cpu_time() - start_process_cpu - generator_cpu;
+    const uint64_t bytes = bridge.get_bytes_processed() - start_bytes;
+    const uint64_t frames_processed = bytes / mt_bridge::get_frame_size(num_symbol);
+    generator.close();
+
+    std::cout << "symbols: " << num_symbol
+        << " frames/s: " << (uint64_t)((double)frames_processed / elapsed)
+        << " MB/s: " << ((double)bytes / elapsed / 1e6)
+        << " bridge CPU: " << (bridge_cpu / elapsed * 100.0) << "%"
+        << " (" << (bridge_cpu / (double)frames_processed * 1e6) << " us/frame)"
+        << " callbacks: " << callbacks
+        << std::endl;
+}
+
+/* задержка: генератор передает кадры с периодом update_ms,
+ * каждый кадр начинает новую секунду сервера и вызывает callback
+ */
+void run_latency(const uint32_t num_symbol, const uint32_t port, const uint32_t update_ms, const uint32_t num_frames) {
+    std::vector<std::chrono::steady_clock::time_point> send_time(num_frames + 1);
+    std::vector<double> latency;
+    latency.reserve(num_frames);
+    std::atomic<uint64_t> last_frame(0);
+    uint64_t start_timestamp = std::time(nullptr);
+
+    Bridge::Config config(port, 10);
+    config.snapshot_callback = [&](
+            const mt_bridge::MtSnapshot<mt_bridge::MtCandle> &/*snapshot*/,
+            const Bridge::EventType /*event*/,
+            const uint64_t /*timestamp*/) {
+        if(event != Bridge::EventType::NEW_TICK) return;
+        if(timestamp <= start_timestamp) return;
+        const uint64_t frame = timestamp - start_timestamp;
+        if(frame > last_frame || frame > num_frames) return;
+        latency.push_back(std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - send_time[frame]).count());
+    };
+    Bridge bridge(config);
+
+    mt_bridge::MtFeedGenerator generator("127.0.0.1", port, num_symbol, 10, 1);
+    generator.start(start_timestamp);
+    bridge.wait();
+    wait_processed(bridge, generator.get_bytes_sent());
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    const auto start = std::chrono::steady_clock::now();
+    for(uint32_t f = 1; f <= num_frames; ++f) {
+        std::this_thread::sleep_until(start + std::chrono::milliseconds(f * update_ms));
+        send_time[f] = std::chrono::steady_clock::now();
+        last_frame = f;
+        generator.send(start_timestamp + f);
+    }
+    wait_processed(bridge, generator.get_bytes_sent());
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    const mt_bridge::MtMetrics metrics = bridge.get_metrics();
+    generator.close();
+
+    std::sort(latency.begin(), latency.end());
+    auto percentile = [&](const double p) -> double {
+        if(latency.empty()) return 0;
+        const size_t index = std::min((size_t)(p * (double)latency.size()), latency.size() - 1);
+        return latency[index] * 1e6;
+    };
+    std::cout << "symbols: " << num_symbol
+        << " frame-to-callback latency at " << update_ms << " ms, us:"
+        << " p50: " << percentile(0.5)
+        << " p90: " << percentile(0.9)
+        << " p99: " << percentile(0.99)
+        << " max: " << percentile(1.0)
+        << " samples: " << latency.size()
+        << std::endl;
+    print_stage("receive to decode", metrics.receive_to_decode);
+    print_stage("decode to store", metrics.decode_to_store);
+    print_stage("store to callback", metrics.store_to_callback);
+    print_stage("callback", metrics.callback);
+    print_stage("lock wait", metrics.lock_wait);
+}
+
+int main() {
+    const uint32_t symbols[] = {26, 500, 5000};
+    uint32_t port = 5580;
+    for(uint32_t num_symbol : symbols) {
+        run_throughput(num_symbol, port++, 2.0);
+    }
+    for(uint32_t num_symbol : symbols) {
+        run_latency(num_symbol, port++, 10, 300);
+    }
+    return 0;
+}
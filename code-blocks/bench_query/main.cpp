@@ -0,0 +1,164 @@
+#include <iostream>
+#include <mt-bridge.hpp>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <atomic>
+#include <functional>
+#include <cstdlib>
+#include <new>
+
+/* замер методов запроса данных моста, которые стратегия вызывает тысячи раз в секунду.
+ * Хранилище баров заполняется напрямую, без соединения с терминалом.
+ * Для разной глубины истории и разного количества потоков-читателей
+ * выводится время одного вызова и количество выделений памяти на вызов
+ */
+
+/* считаем выделения памяти всей программы */
+std::atomic<uint64_t> num_allocations(0);
+
+inline void *count_allocation(const size_t size) {
+    ++num_allocations;
+    void *ptr = std::malloc(size == 0 ? 1 : size);
+    if(ptr == nullptr) throw std::bad_alloc();
+    return ptr;
+}
+
+void *operator new(size_t size) {
+    return count_allocation(size);
+}
+
+void *operator new[](size_t size) {
+    return count_allocation(size);
+}
+
+void operator delete(void *ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete[](void *ptr) noexcept {
+    std::free(ptr);
+}
+
+typedef mt_bridge::MetatraderBridge<mt_bridge::MtCandle> Bridge;
+
+const uint32_t NUM_SYMBOL = 26;
+const uint64_t END_TIMESTAMP = 1577836800; // 01.01.2020, последний бар истории
+
+/* заполняем мост барами всех символов */
+void fill_bridge(Bridge &bridge, const uint32_t hist_len) {
+    std::vector<mt_bridge::MtCandle> candles(hist_len);
+    for(uint32_t s = 0; s < NUM_SYMBOL; ++s) {
+        double price = 1.0 + s * 0.01;
+        for(uint32_t i = 0; i < hist_len; ++i) {
+            const double next_price = price + ((i * 7 + s) % 5 - 2) * 1e-5;
+            candles[i] = mt_bridge::MtCandle(price, std::max(price, next_price), std::min(price, next_price),
+                next_price, 1, END_TIMESTAMP - (hist_len - i - 1) * 60);
+            price = next_price;
+        }
+        bridge.load_candles("SYM" + std::to_string(s), candles);
+    }
+}
+
+/* замер одного метода: каждый поток-читатель вызывает метод заданное время */
+void run(
+        const std::string &name,
+        const uint32_t hist_len,
+        const uint32_t num_readers,
+        const double seconds,
+        std::function<double(const uint32_t thread_index, const uint64_t i)> query) {
+    std::atomic<bool> is_stop(false);
+    std::atomic<uint64_t> calls(0);
+    std::atomic<uint32_t> ready(0);
+    std::vector<double> sink(num_readers, 0);
+    std::vector<std::thread> readers;
+    for(uint32_t r = 0; r < num_readers; ++r) {
+        readers.push_back(std::thread([&, r]() {
+            ++ready;
+            while(ready < num_readers) std::this_thread::yield();
+            uint64_t n = 0;
+            double sum = 0;
+            while(!is_stop.load(std::memory_order_relaxed)) {
+                for(uint32_t k = 0; k < 64; ++k) {
+                    sum += query(r, n++);
+                }
+            }
+            calls += n;
+            sink[r] = sum;
+        }));
+    }
+    while(ready < num_readers) std::this_thread::yield();
+    const uint64_t start_allocations = num_allocations;
+    std::this_thread::sleep_for(std::chrono::milliseconds((uint64_t)(seconds * 1000)));
+    is_stop = true;
+    for(size_t r = 0; r < readers.size(); ++r) readers[r].join();
+    const uint64_t allocations = num_allocations - start_allocations;
+
+    std::cout << name
+        << " bars: " << hist_len
+        << " readers: " << num_readers
+        << " ns/op: " << (seconds * 1e9 * num_readers / (double)calls)
+        << " allocs/op: " << ((double)allocations / (double)calls)
+        << std::endl;
+}
+
+int main() {
+    const double seconds = 0.5;
+    const uint32_t hist_lens[] = {1440, 10080, 100000};
+    const uint32_t readers[] = {1, 4};
+    for(size_t h = 0; h < sizeof(hist_lens) / sizeof(hist_lens[0]); ++h) {
+        const uint32_t hist_len = hist_lens[h];
+        Bridge::Config config(5600 + h);
+        config.is_load_candles = true;
+        Bridge bridge(config);
+        fill_bridge(bridge, hist_len);
+
+        /* метка времени бара, которая каждый вызов разная, но всегда есть в истории */
+        auto get_bar_timestamp = [hist_len](const uint64_t i) {
+            return END_TIMESTAMP - ((i * 7919) % hist_len) * 60;
+        };
+        const uint32_t history_bars = std::min(hist_len, (uint32_t)1440);
+
+        for(size_t k = 0; k < sizeof(readers) / sizeof(readers[0]); ++k) {
+            const uint32_t num_readers = readers[k];
+            std::vector<mt_bridge::MtHistoryMatrix> history(num_readers);
+
+            run("get_bid                ", hist_len, num_readers, seconds,
+                    [&](const uint32_t /*r*/, const uint64_t /*i*/) {
+                return bridge.get_bid(i % NUM_SYMBOL);
+            });
+            run("get_candle             ", hist_len, num_readers, seconds,
+                    [&](const uint32_t /*r*/, const uint64_t /*i*/) {
+                return bridge.get_candle(i % NUM_SYMBOL, i % 16).close;
+            });
+            const std::string symbol_name("SYM7");
+            run("get_candle(name)       ", hist_len, num_readers, seconds,
+                    [&](const uint32_t /*r*/, const uint64_t /*i*/) {
+                return bridge.get_candle(symbol_name).close;
+            });
+            run("get_symbol_handle      ", hist_len, num_readers, seconds,
+                    [&](const uint32_t /*r*/, const uint64_t /*i*/) {
+                return (double)bridge.get_symbol_handle(symbol_name).index;
+            });
+            run("get_timestamp_candle   ", hist_len, num_readers, seconds,
+                    [&](const uint32_t /*r*/, const uint64_t /*i*/) {
+                return bridge.get_timestamp_candle(i % NUM_SYMBOL, get_bar_timestamp(i)).close;
+            });
+            run("get_candles(timestamp) ", hist_len, num_readers, seconds,
+                    [&](const uint32_t /*r*/, const uint64_t /*i*/) {
+                return (double)bridge.get_candles(get_bar_timestamp(i)).size();
+            });
+            run("get_candles(symbol)    ", hist_len, num_readers, seconds,
+                    [&](const uint32_t /*r*/, const uint64_t /*i*/) {
+                return (double)bridge.get_candles(std::string("SYM7")).size();
+            });
+            /* исторические данные для первоначальной инициализации */
+            run("get_history            ", hist_len, num_readers, seconds,
+                    [&](const uint32_t r, const uint64_t i) {
+                bridge.get_history(history[r], END_TIMESTAMP, history_bars);
+                return history[r].get_close(i % NUM_SYMBOL)[0];
+            });
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,125 @@
+#include <iostream>
+#include <mt-bridge-seqlock.hpp>
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <atomic>
+
+/* замер чтения цен при конкуренции: несколько читателей и один писатель.
+ * Сравниваются массивы под общим мьютексом (как было в мосте)
+ * и записи с последовательной блокировкой
+ */
+
+const uint32_t NUM_SYMBOL = 26;
+
+/* старый вариант: массивы bid и ask под одним мьютексом */
+class MutexTable {
+public:
+    std::vector<double> symbol_bid;
+    std::vector<double> symbol_ask;
+    std::vector<uint64_t> symbol_timestamp;
+    std::mutex symbol_tick_mutex;
+
+    MutexTable() : symbol_bid(NUM_SYMBOL), symbol_ask(NUM_SYMBOL), symbol_timestamp(NUM_SYMBOL) {};
+
+    void store(const uint32_t s, const mt_bridge::MtTick &tick) {
+        std::lock_guard<std::mutex> lock(symbol_tick_mutex);
+        symbol_bid[s] = tick.bid;
+        symbol_ask[s] = tick.ask;
+        symbol_timestamp[s] = tick.timestamp;
+    }
+
+    /* get_bid() и get_ask() брали мьютекс по отдельности */
+    mt_bridge::MtTick load(const uint32_t s) {
+        mt_bridge::MtTick tick;
+        {
+            std::lock_guard<std::mutex> lock(symbol_tick_mutex);
+            tick.bid = symbol_bid[s];
+        }
+        {
+            std::lock_guard<std::mutex> lock(symbol_tick_mutex);
+            tick.ask = symbol_ask[s];
+        }
+        return tick;
+    }
+};
+
+/* новый вариант: запись с последовательной блокировкой на символ */
+class SeqlockTable {
+public:
+    mt_bridge::MtStableArray<mt_bridge::MtSeqlock<mt_bridge::MtTick>> symbol_ticks;
+
+    SeqlockTable() {
+        symbol_ticks.grow(NUM_SYMBOL);
+    }
+
+    void store(const uint32_t s, const mt_bridge::MtTick &tick) {
+        symbol_ticks[s].store(tick);
+    }
+
+    mt_bridge::MtTick load(const uint32_t s) {
+        return symbol_ticks[s].load();
+    }
+};
+
+template<class TABLE>
+void run(const std::string &name, const uint32_t num_readers, const double seconds) {
+    TABLE table;
+    std::atomic<bool> is_stop(false);
+    std::atomic<uint64_t> reads(0);
+    std::atomic<uint64_t> inconsistent(0);
+    uint64_t writes = 0;
+
+    std::vector<std::thread> readers;
+    for(uint32_t r = 0; r < num_readers; ++r) {
+        readers.push_back(std::thread([&, r]() {
+            uint64_t n = 0;
+            uint64_t bad = 0;
+            uint32_t s = r % NUM_SYMBOL;
+            while(!is_stop.load(std::memory_order_relaxed)) {
+                const mt_bridge::MtTick tick = table.load(s);
+                /* писатель всегда записывает ask = bid + 1 */
+                if(tick.ask != 0 && tick.ask - tick.bid != 1.0) ++bad;
+                if(++s == NUM_SYMBOL) s = 0;
+                ++n;
+            }
+            reads += n;
+            inconsistent += bad;
+        }));
+    }
+
+    std::thread writer([&]() {
+        double price = 1.0;
+        while(!is_stop.load(std::memory_order_relaxed)) {
+            for(uint32_t s = 0; s < NUM_SYMBOL; ++s) {
+                table.store(s, mt_bridge::MtTick(price, price + 1.0, writes));
+            }
+            price += 0.5;
+            ++writes;
+        }
+    });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds((uint64_t)(seconds * 1000)));
+    is_stop = true;
+    writer.join();
+    for(size_t r = 0; r < readers.size(); ++r) readers[r].join();
+
+    std::cout << name
+        << " readers: " << num_readers
+        << " reads/s: " << (uint64_t)((double)reads / seconds)
+        << " ns/read per reader: " << (seconds * 1e9 * num_readers / (double)reads)
+        << " frames/s: " << (uint64_t)((double)writes / seconds)
+        << " inconsistent bid/ask: " << inconsistent
+        << std::endl;
+}
+
+int main() {
+    const double seconds = 1.0;
+    const uint32_t readers[] = {1, 2, 4, 8};
+    for(size_t i = 0; i < sizeof(readers) / sizeof(readers[0]); ++i) {
+        run<MutexTable>("mutex  ", readers[i], seconds);
+        run<SeqlockTable>("seqlock", readers[i], seconds);
+    }
+    return 0;
+}
@@ -0,0 +1,124 @@
+#include <iostream>
+#include <mt-bridge.hpp>
+#include <mt-bridge-feeder.hpp>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <memory>
+
+/* проверка восстановления сессий: два терминала без имени подключаются
+ * к мосту, разрывают соединение и подключаются снова в обратном порядке.
+ * Затем терминалы подключаются еще раз, не закрыв старые соединения,
+ * как после обрыва связи без FIN. Каждый терминал должен вернуться в слот
+ * своей сессии, сохранить бары и передать только пропущенные бары,
+ * а цены не должны перепутаться
+ */
+
+typedef mt_bridge::MetatraderBridge<mt_bridge::MtCandle> Bridge;
+
+const uint32_t PORT = 5562;
+const uint32_t HIST_LEN = 100;
+
+/// Терминал, который передает один символ
+class Terminal {
+public:
+    uint64_t session_id;
+    double price;
+    uint32_t history_len = 0;
+    std::unique_ptr<mt_bridge::MtFeeder> feeder;
+
+    Terminal(const uint64_t id, const double p) : session_id(id), price(p) {};
+
+    void connect() {
+        feeder.reset(new mt_bridge::MtFeeder("127.0.0.1", PORT));
+        feeder->send_handshake({"EURUSD"}, HIST_LEN, 2, mt_bridge::MT_BRIDGE_HANDSHAKE_HISTORY_REQUEST, session_id);
+        history_len = feeder->receive_history_request();
+        const uint64_t minute = std::time(nullptr) / 60 * 60;
+        std::vector<mt_bridge::MtSymbolRecord> records(1);
+        for(uint32_t h = history_len + 1; h > 0; --h) {
+            records[0].bid = records[0].open = records[0].high = records[0].low = records[0].close = price;
+            records[0].ask = price + 0.0001;
+            records[0].timestamp = minute - (h - 1) * 60;
+            feeder->send_frame(records, std::time(nullptr));
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+
+    void close() {
+        feeder->close();
+        feeder.reset();
+    }
+
+    /** \brief Подключиться заново, не закрывая старое соединение
+     * \return Старое соединение, которое должен закрыть мост
+     */
+    std::unique_ptr<mt_bridge::MtFeeder> reconnect() {
+        std::unique_ptr<mt_bridge::MtFeeder> stale_feeder(std::move(feeder));
+        connect();
+        return stale_feeder;
+    }
+};
+
+int main() {
+    Bridge::Config config(PORT, 5);
+    config.max_terminals = 2;
+    config.io_threads = 2;
+    Bridge bridge(config);
+
+    uint32_t num_errors = 0;
+    Terminal terminal_a(101, 1.1);
+    Terminal terminal_b(202, 2.2);
+    terminal_a.connect();
+    terminal_b.connect();
+    const uint32_t index_a = 0;
+    const uint32_t index_b = 1;
+    const std::string symbol_a = bridge.get_symbol_list()[index_a];
+    const std::string symbol_b = bridge.get_symbol_list()[index_b];
+    const size_t num_candles = bridge.get_candles(symbol_a).size();
+    terminal_a.close();
+    terminal_b.close();
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    /* переподключаемся в обратном порядке с новыми ценами */
+    terminal_a.price = 1.2;
+    terminal_b.price = 2.3;
+    terminal_b.connect();
+    terminal_a.connect();
+
+    /* подключаемся снова, пока старые соединения еще открыты */
+    terminal_a.price = 1.3;
+    terminal_b.price = 2.4;
+    std::unique_ptr<mt_bridge::MtFeeder> stale_b = terminal_b.reconnect();
+    std::unique_ptr<mt_bridge::MtFeeder> stale_a = terminal_a.reconnect();
+    if(!stale_a->wait_closed(1000) || !stale_b->wait_closed(1000)) {
+        std::cout << "error: stale connections are not closed" << std::endl;
+        ++num_errors;
+    }
+
+    const mt_bridge::MtMetrics metrics = bridge.get_metrics();
+    std::cout << symbol_a << " bid: " << bridge.get_bid(index_a)
+        << " candles: " << bridge.get_candles(symbol_a).size() << "/" << num_candles
+        << " history: " << terminal_a.history_len << std::endl;
+    std::cout << symbol_b << " bid: " << bridge.get_bid(index_b)
+        << " candles: " << bridge.get_candles(symbol_b).size() << "/" << num_candles
+        << " history: " << terminal_b.history_len << std::endl;
+    std::cout << "resumes: " << metrics.resumes
+        << " reconnect gap max, us: " << metrics.reconnect_gap.max << std::endl;
+
+    if(bridge.get_bid(index_a) != terminal_a.price || bridge.get_bid(index_b) != terminal_b.price) {
+        std::cout << "error: prices of terminals are mixed up" << std::endl;
+        ++num_errors;
+    }
+    if(metrics.resumes != 4 || terminal_a.history_len >= HIST_LEN || terminal_b.history_len >= HIST_LEN) {
+        std::cout << "error: sessions are not resumed" << std::endl;
+        ++num_errors;
+    }
+    if(bridge.get_candles(symbol_a).size() != num_candles || bridge.get_candles(symbol_b).size() != num_candles) {
+        std::cout << "error: bars are lost" << std::endl;
+        ++num_errors;
+    }
+    terminal_a.close();
+    terminal_b.close();
+    std::cout << "errors: " << num_errors << std::endl;
+    return num_errors == 0 ? 0 : 1;
+}
@@ -0,0 +1,71 @@
+#include <iostream>
+#include <cstdlib>
+#include <mt-bridge.hpp>
+
+/* Воспроизведение записи потока байтов советника
+ *
+ * replay <file.mtbr> [speed] [port]
+ *
+ * speed - скорость воспроизведения: 1 - реальное время, 10 - в 10 раз быстрее, 0 - без пауз
+ * port  - если задан, запись передается в мост на этом порту (заменитель терминала),
+ *         иначе программа сама запускает мост с часами записи и выводит события callback
+ *
+ * Чтобы сделать запись, задайте мосту папку Config::record_path
+ */
+int main(int argc, char *argv[]) {
+    if(argc < 2) {
+        std::cout << "usage: replay <file.mtbr> [speed] [port]" << std::endl;
+        return 0;
+    }
+    const std::string file_name(argv[1]);
+    const double speed = argc > 2 ? std::atof(argv[2]) : 1.0;
+
+    try {
+        if(argc > 3) {
+            /* заменитель терминала для моста в другой программе */
+            mt_bridge::MtReplayer replayer("127.0.0.1", std::atoi(argv[3]));
+            const uint64_t bytes = replayer.replay(file_name, speed);
+            std::cout << "replayed " << bytes << " bytes" << std::endl;
+            replayer.close();
+            return 0;
+        }
+
+        const uint32_t port = 5555;
+        std::shared_ptr<mt_bridge::MtReplayClock> clock = std::make_shared<mt_bridge::MtReplayClock>();
+        mt_bridge::MtBridge::Config config(port, 10);
+        config.clock = clock;
+        config.callback = [&](
+                const std::map<std::string, mt_bridge::MtCandle> &candles,
+                const mt_bridge::MtBridge::EventType event,
+                const uint64_t timestamp) {
+            const mt_bridge::MtCandle &candle = candles.begin()->second;
+            std::cout
+                << (event == mt_bridge::MtBridge::EventType::NEW_TICK ? "tick " : "history ")
+                << timestamp << " "
+                << candles.begin()->first
+                << " close: " << candle.close
+                << " t: " << candle.timestamp
+                << std::endl;
+        };
+        mt_bridge::MtBridge iMT(config);
+
+        mt_bridge::MtReplayer replayer("127.0.0.1", port);
+        replayer.on_time = [&](const double receive_time) {
+            clock->set_time(receive_time);
+        };
+        replayer.get_processed = [&]() {
+            return iMT.get_bytes_processed();
+        };
+        replayer.is_idle = [&]() {
+            return iMT.is_idle();
+        };
+        const uint64_t bytes = replayer.replay(file_name, speed);
+        std::cout << "replayed " << bytes << " bytes" << std::endl;
+        replayer.close();
+    } catch (const char *e) {
+        std::cout << e << std::endl;
+    } catch (std::exception &e) {
+        std::cout << e.what() << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,139 @@
+#include <iostream>
+#include <mt-bridge.hpp>
+#include <mt-bridge-feeder.hpp>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include <atomic>
+
+/* проверка остановки моста: мост много раз создается и удаляется.
+ * Треть циклов проходит без терминала, в остальных к мосту подключены
+ * терминал и подписчик ретрансляции, которые не закрывают соединение сами.
+ * В каждом третьем цикле также работают поток callback и поток тиков
+ * (callback и tick_callback), а терминал передает цены до удаления моста.
+ * Выводится время удаления моста, подписчик должен сразу получить конец потока
+ */
+
+typedef mt_bridge::MetatraderBridge<mt_bridge::MtCandle> Bridge;
+typedef std::chrono::steady_clock::time_point time_point;
+
+const uint32_t PORT = 5560;
+const uint32_t REBROADCAST_PORT = 5561;
+const uint32_t NUM_CYCLES = 300;
+const double MAX_STOP_TIME = 1000.0; // мс, дольше - ошибка
+
+inline double get_ms(const time_point &start, const time_point &stop) {
+    return std::chrono::duration<double, std::milli>(stop - start).count();
+}
+
+int main() {
+    const std::vector<std::string> symbols = {"EURUSD", "GBPUSD"};
+    const uint32_t hist_len = 10;
+    double max_stop_time = 0;
+    double sum_stop_time = 0;
+    uint32_t num_errors = 0;
+    uint64_t total_callbacks = 0;
+    uint64_t total_ticks = 0;
+    const time_point start_time = std::chrono::steady_clock::now();
+    for(uint32_t c = 0; c < NUM_CYCLES; ++c) {
+        const bool is_terminal = c % 3 != 0;
+        const bool is_callback = c % 3 == 2;
+        std::atomic<uint64_t> num_callbacks(0);
+        std::atomic<uint64_t> num_ticks(0);
+        Bridge::Config config(PORT, 5);
+        config.rebroadcast_port = REBROADCAST_PORT;
+        if(is_callback) {
+            config.io_threads = 2;
+            config.callback = [&](
+                    const std::map<std::string, mt_bridge::MtCandle> &/*candles*/,
+                    const Bridge::EventType /*event*/,
+                    const uint64_t /*timestamp*/) {
+                ++num_callbacks;
+            };
+            config.tick_stream_capacity = 1024;
+            config.tick_callback = [&](
+                    const mt_bridge::MtRawTick &/*tick*/,
+                    const Bridge::EventType /*event*/,
+                    const uint64_t /*timestamp*/) {
+                ++num_ticks;
+            };
+        }
+        std::unique_ptr<Bridge> bridge(new Bridge(config));
+
+        std::unique_ptr<mt_bridge::MtFeeder> feeder;
+        const uint64_t minute = std::time(nullptr) / 60 * 60;
+        std::vector<mt_bridge::MtSymbolRecord> records(symbols.size());
+        boost::asio::io_context io_context;
+        boost::asio::ip::tcp::socket subscriber(io_context);
+        if(is_terminal) {
+            feeder.reset(new mt_bridge::MtFeeder("127.0.0.1", PORT));
+            feeder->send_handshake(symbols, hist_len, 2);
+            for(uint32_t h = hist_len + 1; h > 0; --h) {
+                for(size_t s = 0; s < records.size(); ++s) {
+                    records[s].bid = records[s].open = records[s].high = records[s].low = records[s].close = 1.0 + s;
+                    records[s].ask = records[s].bid + 0.0001;
+                    records[s].timestamp = minute - (h - 1) * 60;
+                }
+                feeder->send_frame(records, std::time(nullptr));
+            }
+            if(!bridge->wait()) {
+                std::cout << "cycle " << c << ": no connection" << std::endl;
+                ++num_errors;
+            }
+            subscriber.connect(boost::asio::ip::tcp::endpoint(
+                boost::asio::ip::address::from_string("127.0.0.1"), REBROADCAST_PORT));
+            if(is_callback) {
+                /* мост удаляется, пока потоки callback и тиков получают данные */
+                for(uint32_t i = 0; i < 20; ++i) {
+                    for(size_t s = 0; s < records.size(); ++s) {
+                        records[s].bid = records[s].close = 1.0 + s + i * 0.0001;
+                        records[s].ask = records[s].bid + 0.0001;
+                    }
+                    feeder->send_delta_frame(records, std::time(nullptr));
+                }
+                const time_point wait_time = std::chrono::steady_clock::now();
+                while(num_ticks == 0 && get_ms(wait_time, std::chrono::steady_clock::now()) < MAX_STOP_TIME) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                }
+            }
+        }
+
+        const time_point stop_time = std::chrono::steady_clock::now();
+        bridge.reset();
+        const double stop_ms = get_ms(stop_time, std::chrono::steady_clock::now());
+        max_stop_time = std::max(max_stop_time, stop_ms);
+        sum_stop_time += stop_ms;
+        if(stop_ms > MAX_STOP_TIME) {
+            std::cout << "cycle " << c << ": stop time " << stop_ms << " ms" << std::endl;
+            ++num_errors;
+        }
+
+        if(is_terminal) {
+            /* мост закрыл соединение подписчика, чтение дочитает кадры и вернет конец потока */
+            boost::system::error_code ec;
+            std::vector<uint8_t> buffer(4096);
+            while(!ec) subscriber.read_some(boost::asio::buffer(buffer), ec);
+            if(ec != boost::asio::error::eof && ec != boost::asio::error::connection_reset) {
+                std::cout << "cycle " << c << ": subscriber error " << ec.message() << std::endl;
+                ++num_errors;
+            }
+            feeder->close();
+        }
+        if(is_callback && num_ticks == 0) {
+            std::cout << "cycle " << c << ": no ticks" << std::endl;
+            ++num_errors;
+        }
+        total_callbacks += num_callbacks;
+        total_ticks += num_ticks;
+    }
+    std::cout << "cycles: " << NUM_CYCLES
+        << " total, ms: " << get_ms(start_time, std::chrono::steady_clock::now())
+        << " stop avg, ms: " << sum_stop_time / NUM_CYCLES
+        << " stop max, ms: " << max_stop_time
+        << " callbacks: " << total_callbacks
+        << " ticks: " << total_ticks
+        << " errors: " << num_errors
+        << std::endl;
+    return num_errors == 0 ? 0 : 1;
+}
@@ -0,0 +1,240 @@
+#ifndef METATRADER_BRIDGE_BUFFER_HPP_INCLUDED
+#define METATRADER_BRIDGE_BUFFER_HPP_INCLUDED
+
+#include <boost/asio.hpp>
+#include <vector>
+#include <string>
+#include <cstring>
+#include <cstdint>
+
+namespace mt_bridge {
+
+    const size_t MT_BRIDGE_SYMBOL_NAME_SIZE = 32;       /**< Размер имени символа в протоколе */
+    const size_t MT_BRIDGE_SYMBOL_RECORD_SIZE = 64;     /**< Размер записи символа в кадре */
+    const size_t MT_BRIDGE_SERVER_TIMESTAMP_SIZE = 8;   /**< Размер метки времени сервера в кадре */
+    const size_t MT_BRIDGE_READ_BUFFER_SIZE = 65536;    /**< Размер буфера чтения по умолчанию */
+
+    /** \brief Прочитать значение из массива байтов
+     * \param data Указатель на данные
+     * \return Значение
+     */
+    template<class T>
+    inline T decode_value(const uint8_t *data) {
+        T value;
+        std::memcpy(&value, data, sizeof(T));
+        return value;
+    }
+
+    /** \brief Запись символа в кадре данных
+     *
+     * Советник передает для каждого символа 8 полей по 8 байт:
+     * bid, ask, open, high, low, close, volume, timestamp
+     */
+    class MtSymbolRecord {
+    public:
+        double bid;
+        double ask;
+        double open;
+        double high;
+        double low;
+        double close;
+        uint64_t volume;
+        uint64_t timestamp;
+
+        MtSymbolRecord() :
+            bid(0), ask(0), open(0), high(0), low(0), close(0),
+            volume(0), timestamp(0) {
+        }
+    };
+
+    /** \brief Декодировать запись символа
+     * \param data Указатель на начало записи (MT_BRIDGE_SYMBOL_RECORD_SIZE байт)
+     * \param record Запись символа
+     */
+    inline void decode_symbol_record(const uint8_t *data, MtSymbolRecord &record) {
+        record.bid = decode_value<double>(data);
+        record.ask = decode_value<double>(data + 8);
+        record.open = decode_value<double>(data + 16);
+        record.high = decode_value<double>(data + 24);
+        record.low = decode_value<double>(data + 32);
+        record.close = decode_value<double>(data + 40);
+        record.volume = decode_value<uint64_t>(data + 48);
+        record.timestamp = decode_value<uint64_t>(data + 56);
+    }
+
+    /** \brief Записать запись символа в массив байтов
+     * \param record Запись символа
+     * \param data Указатель на начало записи (MT_BRIDGE_SYMBOL_RECORD_SIZE байт)
+     */
+    inline void encode_symbol_record(const MtSymbolRecord &record, uint8_t *data) {
+        std::memcpy(data, &record.bid, 8);
+        std::memcpy(data + 8, &record.ask, 8);
+        std::memcpy(data + 16, &record.open, 8);
+        std::memcpy(data + 24, &record.high, 8);
+        std::memcpy(data + 32, &record.low, 8);
+        std::memcpy(data + 40, &record.close, 8);
+        std::memcpy(data + 48, &record.volume, 8);
+        std::memcpy(data + 56, &record.timestamp, 8);
+    }
+
+    /** \brief Получить размер кадра данных
+     * \param num_symbol Количество символов
+     * \return Размер кадра в байтах
+     */
+    inline size_t get_frame_size(const uint32_t num_symbol) {
+        return (size_t)num_symbol * MT_BRIDGE_SYMBOL_RECORD_SIZE +
+            MT_BRIDGE_SERVER_TIMESTAMP_SIZE;
+    }
+
+    /** \brief Буфер чтения
+     *
+     * Многоразовый буфер, в который данные сокета дописываются в конец,
+     * а прочитанные данные удаляются из начала
+     */
+    class MtReadBuffer {
+    private:
+        std::vector<uint8_t> buffer;
+        size_t begin_pos = 0;
+        size_t end_pos = 0;
+    public:
+
+        MtReadBuffer(const size_t capacity = MT_BRIDGE_READ_BUFFER_SIZE) :
+            buffer(capacity) {
+        }
+
+        /** \brief Получить количество непрочитанных байтов
+         * \return Количество байтов
+         */
+        inline size_t size() const {
+            return end_pos - begin_pos;
+        }
+
+        /** \brief Получить указатель на непрочитанные данные
+         * \return Указатель на данные
+         */
+        inline const uint8_t *data() const {
+            return buffer.data() + begin_pos;
+        }
+
+        /** \brief Удалить прочитанные данные
+         * \param len Количество байтов
+         */
+        inline void consume(const size_t len) {
+            begin_pos += len;
+            if(begin_pos >= end_pos) begin_pos = end_pos = 0;
+        }
+
+        /** \brief Подготовить место для записи
+         *
+         * Метод сдвигает непрочитанные данные в начало буфера и при
+         * необходимости увеличивает буфер так, чтобы в нем поместилось
+         * не менее min_size непрочитанных байтов
+         * \param min_size Минимальный размер непрочитанных данных
+         * \return Буфер для записи
+         */
+        inline boost::asio::mutable_buffer prepare(const size_t min_size) {
+            if(begin_pos > 0) {
+                const size_t len = size();
+                if(len > 0) std::memmove(buffer.data(), buffer.data() + begin_pos, len);
+                begin_pos = 0;
+                end_pos = len;
+            }
+            if(buffer.size() < min_size) buffer.resize(min_size);
+            return boost::asio::buffer(buffer.data() + end_pos, buffer.size() - end_pos);
+        }
+
+        /** \brief Подтвердить запись данных в буфер
+         * \param len Количество записанных байтов
+         */
+        inline void commit(const size_t len) {
+            end_pos += len;
+        }
+
+        inline void clear() {
+            begin_pos = end_pos = 0;
+        }
+    };
+
+    /** \brief Буферизированный читатель потока
+     *
+     * Вместо одного вызова read на каждое поле читатель забирает из сокета
+     * столько данных, сколько есть (но не меньше нужного), и выдает
+     * поля и целые кадры из буфера
+     */
+    template<class SyncReadStream>
+    class MtBufferedReader {
+    private:
+        SyncReadStream &stream;
+        MtReadBuffer buffer;
+    public:
+
+        MtBufferedReader(SyncReadStream &s, const size_t capacity = MT_BRIDGE_READ_BUFFER_SIZE) :
+            stream(s), buffer(capacity) {
+        }
+
+        /** \brief Дождаться данных в буфере
+         * \param len Количество байтов, которое должно быть в буфере
+         */
+        void fill(const size_t len) {
+            if(buffer.size() >= len) return;
+            buffer.prepare(len);
+            while(buffer.size() < len) {
+                size_t bytes = stream.read_some(buffer.prepare(len));
+                buffer.commit(bytes);
+            }
+        }
+
+        /** \brief Прочитать блок данных
+         *
+         * Указатель действителен до следующего вызова методов чтения
+         * \param len Размер блока данных
+         * \return Указатель на начало блока
+         */
+        const uint8_t *read(const size_t len) {
+            fill(len);
+            const uint8_t *ptr = buffer.data();
+            buffer.consume(len);
+            return ptr;
+        }
+
+        /** \brief Прочитать кадр данных
+         * \param num_symbol Количество символов
+         * \return Указатель на начало кадра
+         */
+        inline const uint8_t *read_frame(const uint32_t num_symbol) {
+            return read(get_frame_size(num_symbol));
+        }
+
+        /** \brief Прочитать string
+         * \return Строка
+         */
+        std::string read_string() {
+            const char *data = (const char*)read(MT_BRIDGE_SYMBOL_NAME_SIZE);
+            size_t copy_bytes = strnlen(data, MT_BRIDGE_SYMBOL_NAME_SIZE);
+            return std::string(data, copy_bytes);
+        }
+
+        /** \brief Прочитать uint32_t
+         * \return значение числа типа uint32_t
+         */
+        inline uint32_t read_uint32() {
+            return decode_value<uint32_t>(read(sizeof(uint32_t)));
+        }
+
+        /** \brief Прочитать double
+         * \return значение числа типа double
+         */
+        inline double read_double() {
+            return decode_value<double>(read(sizeof(double)));
+        }
+
+        /** \brief Прочитать uint64_t
+         * \return значение числа типа uint64_t
+         */
+        inline uint64_t read_uint64() {
+            return decode_value<uint64_t>(read(sizeof(uint64_t)));
+        }
+    };
+};
+
+#endif // METATRADER_BRIDGE_BUFFER_HPP_INCLUDED
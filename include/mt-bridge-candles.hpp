@@ -0,0 +1,294 @@
+#ifndef METATRADER_BRIDGE_CANDLES_HPP_INCLUDED
+#define METATRADER_BRIDGE_CANDLES_HPP_INCLUDED
+
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+
+namespace mt_bridge {
+
+    /** \brief Кольцевой буфер
+     *
+     * Буфер растет (с копированием) только пока не достигнет максимальной емкости,
+     * после этого новый элемент перезаписывает самый старый.
+     * Максимальная емкость 0 означает буфер без ограничения размера
+     */
+    template<class T>
+    class MtRingBuffer {
+    private:
+        std::vector<T> buffer;
+        size_t head = 0;
+        size_t count = 0;
+        size_t max_capacity = 0;
+
+        inline size_t get_pos(const size_t index) const {
+            const size_t pos = head + index;
+            return pos < buffer.size() ? pos : pos - buffer.size();
+        }
+
+        void grow() {
+            size_t new_capacity = std::max(buffer.size() * 2, (size_t)16);
+            if(max_capacity != 0) new_capacity = std::min(new_capacity, max_capacity);
+            std::vector<T> temp(new_capacity);
+            for(size_t i = 0; i < count; ++i) {
+                temp[i] = buffer[get_pos(i)];
+            }
+            buffer.swap(temp);
+            head = 0;
+        }
+
+    public:
+
+        MtRingBuffer(const size_t capacity = 0) : max_capacity(capacity) {};
+
+        inline size_t size() const {
+            return count;
+        }
+
+        inline bool empty() const {
+            return count == 0;
+        }
+
+        /** \brief Проверить, достиг ли буфер максимальной емкости
+         * \return Вернет true, если следующий элемент перезапишет самый старый
+         */
+        inline bool full() const {
+            return max_capacity != 0 && count == max_capacity;
+        }
+
+        inline T &operator[](const size_t index) {
+            return buffer[get_pos(index)];
+        }
+
+        inline const T &operator[](const size_t index) const {
+            return buffer[get_pos(index)];
+        }
+
+        inline T &front() {
+            return buffer[head];
+        }
+
+        inline const T &front() const {
+            return buffer[head];
+        }
+
+        inline T &back() {
+            return buffer[get_pos(count - 1)];
+        }
+
+        inline const T &back() const {
+            return buffer[get_pos(count - 1)];
+        }
+
+        /** \brief Добавить элемент в конец
+         *
+         * Если буфер полон, самый старый элемент перезаписывается
+         * \param value Элемент
+         */
+        inline void push_back(const T &value) {
+            if(count == buffer.size()) {
+                if(full()) {
+                    buffer[head] = value;
+                    head = get_pos(1);
+                    return;
+                }
+                grow();
+            }
+            buffer[get_pos(count)] = value;
+            ++count;
+        }
+
+        inline void pop_front() {
+            head = get_pos(1);
+            if(--count == 0) head = 0;
+        }
+
+        inline void clear() {
+            head = 0;
+            count = 0;
+        }
+    };
+
+    /** \brief Хранилище баров символа
+     *
+     * Бары лежат на сетке с шагом period (по умолчанию 60 секунд), поэтому кроме массива баров
+     * хранилище ведет индекс по смещению периода от первого бара.
+     * Поиск бара по метке времени выполняется за O(1), пропуски
+     * (например, выходные) отмечаются в индексе нулем. Пропуск ограничен
+     * глубиной истории по времени или MT_CANDLE_STORE_MAX_GAP периодами:
+     * после большего скачка метки времени (например, после бара с ошибочной
+     * меткой времени) индекс строится заново с нового бара, а старые бары
+     * остаются в массиве, но не находятся по метке времени.
+     *
+     * Глубину истории можно ограничить количеством баров и/или временем.
+     * Бары хранятся в кольцевом буфере, который после заполнения
+     * не перераспределяет память. Вытесненные бары передаются в функцию spill
+     */
+    const uint64_t MT_CANDLE_STORE_MAX_GAP = 65536;    /**< Максимальный пропуск в индексе хранилища баров в периодах (для M1 больше 45 дней) */
+
+    template<class CANDLE_TYPE>
+    class MtCandleStore {
+    private:
+        MtRingBuffer<CANDLE_TYPE> candles;
+        MtRingBuffer<uint64_t> period_index;    /**< Номер бара + 1 по смещению периода от первого бара, 0 - бара нет */
+        uint64_t first_period = 0;              /**< Номер периода первого бара */
+        uint64_t first_sequence = 0;            /**< Номер первого бара среди всех добавленных баров */
+        uint64_t max_seconds = 0;               /**< Глубина истории по времени, 0 - без ограничения */
+        uint64_t period = 60;                   /**< Период баров в секундах */
+
+        inline void add_index(const uint64_t timestamp, const uint64_t sequence) {
+            const uint64_t period_number = timestamp / period;
+            if(period_index.empty()) first_period = period_number;
+            const uint64_t max_gap = std::max(MT_CANDLE_STORE_MAX_GAP, max_seconds / period);
+            if(period_number - first_period >= period_index.size() + max_gap) {
+                /* скачок метки времени, не заполняем индекс нулями */
+                period_index.clear();
+                first_period = period_number;
+            }
+            const uint64_t offset = period_number - first_period;
+            while(offset >= period_index.size()) period_index.push_back(0);
+            period_index[offset] = sequence + 1;
+        }
+
+        /** \brief Удалить самый старый бар
+         * \param spill Функция, которая получает вытесненный бар
+         */
+        template<class SPILL>
+        inline void evict(SPILL &spill) {
+            spill(candles.front());
+            candles.pop_front();
+            ++first_sequence;
+            if(candles.empty()) {
+                period_index.clear();
+                return;
+            }
+            const uint64_t period_number = candles.front().timestamp / period;
+            while(first_period < period_number && !period_index.empty()) {
+                period_index.pop_front();
+                ++first_period;
+            }
+        }
+
+        class NoSpill {
+        public:
+            inline void operator()(const CANDLE_TYPE &) const {};
+        };
+
+    public:
+
+        /** \brief Конструктор хранилища баров
+         * \param retention_bars Максимальное количество баров, 0 - без ограничения
+         * \param retention_seconds Максимальная глубина истории в секундах, 0 - без ограничения
+         * \param bar_period Период баров в секундах
+         */
+        MtCandleStore(
+                const size_t retention_bars = 0,
+                const uint64_t retention_seconds = 0,
+                const uint64_t bar_period = 60) :
+            candles(retention_bars), max_seconds(retention_seconds), period(bar_period) {
+        }
+
+        inline uint64_t get_period() const {
+            return period;
+        }
+
+        inline size_t size() const {
+            return candles.size();
+        }
+
+        inline bool empty() const {
+            return candles.empty();
+        }
+
+        inline const CANDLE_TYPE &back() const {
+            return candles.back();
+        }
+
+        inline const CANDLE_TYPE &operator[](const size_t pos) const {
+            return candles[pos];
+        }
+
+        /** \brief Получить копию всех баров
+         * \return Массив баров
+         */
+        std::vector<CANDLE_TYPE> get_candles() const {
+            std::vector<CANDLE_TYPE> temp(candles.size());
+            for(size_t i = 0; i < candles.size(); ++i) {
+                temp[i] = candles[i];
+            }
+            return temp;
+        }
+
+        inline void clear() {
+            candles.clear();
+            period_index.clear();
+            first_period = 0;
+            first_sequence = 0;
+        }
+
+        /** \brief Обновить бар
+         *
+         * Если бар новее последнего, он добавляется в конец.
+         * Если метка времени совпадает с последним баром, последний бар обновляется.
+         * Более старые бары игнорируются
+         * \param candle Бар
+         * \param spill Функция, которая получает вытесненные бары
+         * \return Вернет true, если бар добавлен или обновлен
+         */
+        template<class SPILL>
+        bool update(const CANDLE_TYPE &candle, SPILL &&spill) {
+            if(candles.empty() || candles.back().timestamp < candle.timestamp) {
+                if(candles.full()) evict(spill);
+                if(max_seconds != 0) {
+                    while(!candles.empty() && (candles.front().timestamp + max_seconds) <= candle.timestamp) {
+                        evict(spill);
+                    }
+                }
+                candles.push_back(candle);
+                add_index(candle.timestamp, first_sequence + candles.size() - 1);
+                return true;
+            }
+            if(candles.back().timestamp == candle.timestamp) {
+                candles.back() = candle;
+                return true;
+            }
+            return false;
+        }
+
+        /** \brief Обновить бар
+         * \param candle Бар
+         * \return Вернет true, если бар добавлен или обновлен
+         */
+        inline bool update(const CANDLE_TYPE &candle) {
+            return update(candle, NoSpill());
+        }
+
+        /** \brief Сдвинуть метки времени всех баров
+         *
+         * Смещение должно быть кратно периоду баров (смещение часового пояса кратно 15 минутам)
+         * \param offset Смещение в секундах
+         */
+        void shift_timestamps(const int64_t offset) {
+            for(size_t i = 0; i < candles.size(); ++i) {
+                candles[i].timestamp += offset;
+            }
+            if(!period_index.empty()) first_period = (uint64_t)((int64_t)first_period + offset / (int64_t)period);
+        }
+
+        /** \brief Найти бар по метке времени
+         * \param timestamp Метка времени любой секунды внутри периода бара
+         * \return Указатель на бар или nullptr, если бара нет
+         */
+        inline const CANDLE_TYPE *find(const uint64_t timestamp) const {
+            const uint64_t period_number = timestamp / period;
+            if(period_number < first_period) return nullptr;
+            const uint64_t offset = period_number - first_period;
+            if(offset >= period_index.size()) return nullptr;
+            const uint64_t sequence = period_index[offset];
+            if(sequence == 0 || sequence - 1 < first_sequence) return nullptr;
+            return &candles[sequence - 1 - first_sequence];
+        }
+    };
+};
+
+#endif // METATRADER_BRIDGE_CANDLES_HPP_INCLUDED
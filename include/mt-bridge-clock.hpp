@@ -0,0 +1,162 @@
+#ifndef METATRADER_BRIDGE_CLOCK_HPP_INCLUDED
+#define METATRADER_BRIDGE_CLOCK_HPP_INCLUDED
+
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <functional>
+#include <cstdint>
+#include <ctime>
+
+namespace mt_bridge {
+
+    /** \brief Часы моста
+     *
+     * Мост берет время компьютера только из часов, поэтому часы
+     * можно подменить, например, чтобы воспроизвести записанный поток
+     * данных быстрее реального времени
+     */
+    class MtClock {
+    private:
+        std::function<void()> listener;
+        std::mutex listener_mutex;
+
+    protected:
+
+        /** \brief Сообщить мосту, что время изменилось скачком
+         */
+        void notify_listener() {
+            std::lock_guard<std::mutex> lock(listener_mutex);
+            if(listener != nullptr) listener();
+        }
+
+    public:
+
+        virtual ~MtClock() {};
+
+        /** \brief Получить время
+         * \return Метка времени UTC в секундах с дробной частью
+         */
+        virtual double get_time() = 0;
+
+        /** \brief Получить время в наносекундах
+         *
+         * В double метка времени UTC хранится с точностью около 0.2 мкс,
+         * поэтому часы с высоким разрешением переопределяют этот метод
+         * \return Метка времени UTC в наносекундах
+         */
+        virtual uint64_t get_time_ns() {
+            return (uint64_t)(get_time() * 1e9 + 0.5);
+        }
+
+        /** \brief Задать функцию, которую часы вызывают при скачке времени
+         * \param callback Функция или nullptr
+         */
+        void set_listener(std::function<void()> callback) {
+            std::lock_guard<std::mutex> lock(listener_mutex);
+            listener = callback;
+        }
+    };
+
+    /** \brief Часы компьютера
+     *
+     * Время считается по монотонным часам, привязанным к часам реального
+     * времени, поэтому вызов стоит одного чтения монотонных часов (vDSO
+     * clock_gettime на Linux), а разрешение - наносекунды. Чтобы время не
+     * уходило от часов реального времени после их подстройки (NTP),
+     * привязка обновляется раз в RESYNC_PERIOD_NS
+     */
+    class MtSystemClock : public MtClock {
+    private:
+        static const int64_t NS_IN_SECOND = 1000000000;
+        static const int64_t RESYNC_PERIOD_NS = 60 * NS_IN_SECOND;
+
+        std::atomic<int64_t> offset_ns;     /**< Время реального времени минус время монотонных часов */
+        std::atomic<int64_t> sync_ns;       /**< Время монотонных часов последней привязки */
+
+        static inline int64_t get_monotonic_ns() {
+#if defined(_WIN32)
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+#else
+            timespec ts;
+            clock_gettime(CLOCK_MONOTONIC, &ts);
+            return (int64_t)ts.tv_sec * NS_IN_SECOND + ts.tv_nsec;
+#endif
+        }
+
+        static inline int64_t get_realtime_ns() {
+#if defined(_WIN32)
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count();
+#else
+            timespec ts;
+            clock_gettime(CLOCK_REALTIME, &ts);
+            return (int64_t)ts.tv_sec * NS_IN_SECOND + ts.tv_nsec;
+#endif
+        }
+
+        /** \brief Привязать монотонные часы к часам реального времени
+         * \param monotonic_ns Время монотонных часов
+         */
+        inline void sync(const int64_t monotonic_ns) {
+            offset_ns.store(get_realtime_ns() - monotonic_ns, std::memory_order_relaxed);
+        }
+
+    public:
+
+        MtSystemClock() {
+            const int64_t monotonic_ns = get_monotonic_ns();
+            sync(monotonic_ns);
+            sync_ns = monotonic_ns;
+        }
+
+        uint64_t get_time_ns() override {
+            const int64_t monotonic_ns = get_monotonic_ns();
+            int64_t last_sync_ns = sync_ns.load(std::memory_order_relaxed);
+            if((monotonic_ns - last_sync_ns) > RESYNC_PERIOD_NS &&
+                sync_ns.compare_exchange_strong(last_sync_ns, monotonic_ns, std::memory_order_relaxed)) {
+                sync(monotonic_ns);
+            }
+            return (uint64_t)(monotonic_ns + offset_ns.load(std::memory_order_relaxed));
+        }
+
+        double get_time() override {
+            return (double)get_time_ns() / (double)NS_IN_SECOND;
+        }
+    };
+
+    /** \brief Часы, которые переводит пользователь
+     *
+     * Нужны для воспроизведения записи: перед передачей очередного блока
+     * данных часы переводятся на время, когда этот блок был получен
+     */
+    class MtReplayClock : public MtClock {
+    private:
+        std::atomic<double> time;
+
+    public:
+
+        MtReplayClock(const double t = 0) {
+            time = t;
+        }
+
+        double get_time() override {
+            return time;
+        }
+
+        uint64_t get_time_ns() override {
+            return (uint64_t)(time * 1e9 + 0.5);
+        }
+
+        /** \brief Перевести часы
+         * \param t Метка времени UTC в секундах с дробной частью
+         */
+        void set_time(const double t) {
+            time = t;
+            notify_listener();
+        }
+    };
+};
+
+#endif // METATRADER_BRIDGE_CLOCK_HPP_INCLUDED
@@ -0,0 +1,445 @@
+#ifndef METATRADER_BRIDGE_FEEDER_HPP_INCLUDED
+#define METATRADER_BRIDGE_FEEDER_HPP_INCLUDED
+
+#include "mt-bridge-buffer.hpp"
+#include "mt-bridge-protocol.hpp"
+#include <boost/asio.hpp>
+#include <vector>
+#include <functional>
+#include <string>
+#include <cstring>
+#include <algorithm>
+#include <random>
+#include <thread>
+#include <chrono>
+#include <ctime>
+
+namespace mt_bridge {
+
+    /** \brief Дописать значение в массив байтов
+     * \param buffer Массив байтов
+     * \param value Значение
+     */
+    template<class T>
+    inline void encode_value(std::vector<uint8_t> &buffer, const T value) {
+        const size_t pos = buffer.size();
+        buffer.resize(pos + sizeof(T));
+        std::memcpy(buffer.data() + pos, &value, sizeof(T));
+    }
+
+    /** \brief Дописать запись символа в массив байтов
+     * \param buffer Массив байтов
+     * \param record Запись символа
+     */
+    inline void encode_symbol_record(std::vector<uint8_t> &buffer, const MtSymbolRecord &record) {
+        encode_value<double>(buffer, record.bid);
+        encode_value<double>(buffer, record.ask);
+        encode_value<double>(buffer, record.open);
+        encode_value<double>(buffer, record.high);
+        encode_value<double>(buffer, record.low);
+        encode_value<double>(buffer, record.close);
+        encode_value<uint64_t>(buffer, record.volume);
+        encode_value<uint64_t>(buffer, record.timestamp);
+    }
+
+    /** \brief Дописать кадр данных в массив байтов
+     * \param buffer Массив байтов
+     * \param records Записи всех символов
+     * \param server_timestamp Метка времени сервера
+     */
+    inline void encode_frame(
+            std::vector<uint8_t> &buffer,
+            const std::vector<MtSymbolRecord> &records,
+            const uint64_t server_timestamp) {
+        buffer.reserve(buffer.size() + get_frame_size(records.size()));
+        for(size_t s = 0; s < records.size(); ++s) {
+            encode_symbol_record(buffer, records[s]);
+        }
+        encode_value<uint64_t>(buffer, server_timestamp);
+    }
+
+    /** \brief Дописать кадр DELTA в массив байтов
+     *
+     * Поля сравниваются побитно, поэтому изменение NaN на NaN тоже не передается
+     * \param buffer Массив байтов
+     * \param last_records Записи всех символов из последнего переданного кадра
+     * \param records Записи всех символов
+     * \param server_timestamp Метка времени сервера
+     */
+    inline void encode_delta_frame(
+            std::vector<uint8_t> &buffer,
+            const std::vector<MtSymbolRecord> &last_records,
+            const std::vector<MtSymbolRecord> &records,
+            const uint64_t server_timestamp) {
+        const uint32_t num_symbol = records.size();
+        buffer.reserve(buffer.size() + get_max_delta_frame_size(num_symbol));
+        encode_value<uint64_t>(buffer, server_timestamp);
+        const size_t bitmap_pos = buffer.size();
+        buffer.resize(buffer.size() + get_delta_bitmap_size(num_symbol), 0);
+        for(uint32_t s = 0; s < num_symbol; ++s) {
+            uint8_t last_fields[MT_BRIDGE_SYMBOL_RECORD_SIZE];
+            uint8_t fields[MT_BRIDGE_SYMBOL_RECORD_SIZE];
+            encode_symbol_record(last_records[s], last_fields);
+            encode_symbol_record(records[s], fields);
+            uint8_t field_mask = 0;
+            for(size_t f = 0; f < MT_BRIDGE_SYMBOL_RECORD_FIELDS; ++f) {
+                if(std::memcmp(last_fields + f * 8, fields + f * 8, 8) != 0) field_mask |= 1 << f;
+            }
+            if(field_mask == 0) continue;
+            buffer[bitmap_pos + s / 8] |= 1 << (s % 8);
+            buffer.push_back(field_mask);
+            for(size_t f = 0; f < MT_BRIDGE_SYMBOL_RECORD_FIELDS; ++f) {
+                if((field_mask & (1 << f)) == 0) continue;
+                buffer.insert(buffer.end(), fields + f * 8, fields + f * 8 + 8);
+            }
+        }
+    }
+
+    /** \brief Заменитель советника MT-Bridge
+     *
+     * Класс подключается к MetatraderBridge и передает данные
+     * по протоколу советника MT-Bridge.mq4 (версии 1 или 2). Нужен для тестов
+     * и замеров производительности без терминала Metatrader
+     */
+    class MtFeeder {
+    private:
+        boost::asio::io_context io_context;
+        boost::asio::ip::tcp::socket socket;
+        std::vector<uint8_t> buffer;
+        std::vector<uint8_t> payload;
+        std::vector<MtSymbolRecord> last_records;
+        uint32_t protocol_version = 1;
+        uint32_t sequence = 0;
+        uint64_t bytes_sent = 0;
+
+        void send_buffer() {
+            boost::asio::write(socket, boost::asio::buffer(buffer));
+            bytes_sent += buffer.size();
+            buffer.clear();
+        }
+
+        /** \brief Передать данные, для версии 2 - одним кадром с заголовком
+         * \param type Тип кадра
+         */
+        void send_payload(const MtFrameType type) {
+            if(protocol_version >= MT_BRIDGE_FRAME_VERSION) {
+                encode_frame_header(buffer, MtFrameHeader(type, sequence++, payload.size()));
+            }
+            buffer.insert(buffer.end(), payload.begin(), payload.end());
+            payload.clear();
+            send_buffer();
+        }
+
+    public:
+
+        /** \brief Конструктор заменителя советника
+         * \param host Имя хоста сервера
+         * \param port Номер порта сервера
+         */
+        MtFeeder(const std::string &host, const uint32_t port) :
+                socket(io_context) {
+            boost::asio::ip::tcp::resolver resolver(io_context);
+            boost::asio::connect(socket, resolver.resolve(host, std::to_string(port)));
+            socket.set_option(boost::asio::ip::tcp::no_delay(true));
+        }
+
+        /** \brief Передать заголовок соединения
+         * \param symbols Список символов
+         * \param hist_len Глубина исторических данных
+         * \param version Версия протокола
+         * \param flags Флаги заголовка соединения (только для версии 2), например MT_BRIDGE_HANDSHAKE_HISTORY_REQUEST
+         * \param session_id Идентификатор сессии (только для версии 2), 0 - не передавать
+         * \param terminal_name Имя терминала (только для версии 2), пустая строка - не передавать
+         */
+        void send_handshake(
+                const std::vector<std::string> &symbols,
+                const uint32_t hist_len,
+                const uint32_t version = 1,
+                const uint32_t flags = 0,
+                const uint64_t session_id = 0,
+                const std::string &terminal_name = std::string()) {
+            protocol_version = version;
+            sequence = 0;
+            last_records.clear();
+            if(protocol_version < MT_BRIDGE_FRAME_VERSION) encode_value<uint32_t>(payload, version);
+            encode_value<uint32_t>(payload, (uint32_t)symbols.size());
+            for(size_t s = 0; s < symbols.size(); ++s) {
+                char name[MT_BRIDGE_SYMBOL_NAME_SIZE];
+                std::memset(name, 0, sizeof(name));
+                std::memcpy(name, symbols[s].data(), std::min(symbols[s].size(), sizeof(name)));
+                payload.insert(payload.end(), name, name + sizeof(name));
+            }
+            encode_value<uint32_t>(payload, hist_len);
+            if(protocol_version >= MT_BRIDGE_FRAME_VERSION) {
+                uint32_t handshake_flags = flags;
+                if(session_id != 0) handshake_flags |= MT_BRIDGE_HANDSHAKE_SESSION_ID;
+                if(!terminal_name.empty()) handshake_flags |= MT_BRIDGE_HANDSHAKE_TERMINAL_NAME;
+                if(handshake_flags != 0) encode_value<uint32_t>(payload, handshake_flags);
+                if(session_id != 0) encode_value<uint64_t>(payload, session_id);
+                if(!terminal_name.empty()) {
+                    char name[MT_BRIDGE_SYMBOL_NAME_SIZE];
+                    std::memset(name, 0, sizeof(name));
+                    std::memcpy(name, terminal_name.data(), std::min(terminal_name.size(), sizeof(name)));
+                    payload.insert(payload.end(), name, name + sizeof(name));
+                }
+            }
+            send_payload(MtFrameType::HANDSHAKE);
+        }
+
+        /** \brief Принять кадр HISTORY_REQUEST
+         *
+         * Нужен, если заголовок соединения передан с флагом MT_BRIDGE_HANDSHAKE_HISTORY_REQUEST
+         * \return Количество баров истории, которое просит передать мост
+         */
+        uint32_t receive_history_request() {
+            uint8_t data[MT_BRIDGE_FRAME_HEADER_SIZE + sizeof(uint32_t)];
+            boost::asio::read(socket, boost::asio::buffer(data, sizeof(data)));
+            MtFrameHeader header;
+            decode_frame_header(data, header);
+            if(header.magic != MT_BRIDGE_FRAME_MAGIC ||
+                header.type != (uint16_t)MtFrameType::HISTORY_REQUEST ||
+                header.length != sizeof(uint32_t))
+                throw("Error! Invalid history request frame");
+            return decode_value<uint32_t>(data + MT_BRIDGE_FRAME_HEADER_SIZE);
+        }
+
+        /** \brief Передать кадр данных одним блоком
+         * \param records Записи всех символов
+         * \param server_timestamp Метка времени сервера
+         */
+        void send_frame(
+                const std::vector<MtSymbolRecord> &records,
+                const uint64_t server_timestamp) {
+            encode_frame(payload, records, server_timestamp);
+            send_payload(MtFrameType::SNAPSHOT);
+            last_records = records;
+        }
+
+        /** \brief Передать только изменившиеся поля символов
+         *
+         * Нужен протокол версии 2. Первый кадр соединения передается полностью
+         * \param records Записи всех символов
+         * \param server_timestamp Метка времени сервера
+         */
+        void send_delta_frame(
+                const std::vector<MtSymbolRecord> &records,
+                const uint64_t server_timestamp) {
+            if(protocol_version < MT_BRIDGE_FRAME_VERSION || last_records.size() != records.size()) {
+                send_frame(records, server_timestamp);
+                return;
+            }
+            encode_delta_frame(payload, last_records, records, server_timestamp);
+            send_payload(MtFrameType::DELTA);
+            last_records = records;
+        }
+
+        /** \brief Получить количество переданных байтов
+         * \return Количество байтов с момента создания
+         */
+        inline uint64_t get_bytes_sent() const {
+            return bytes_sent;
+        }
+
+        /** \brief Передать кадр данных по одному полю за вызов, как это делает советник версии 1
+         * \param records Записи всех символов
+         * \param server_timestamp Метка времени сервера
+         */
+        void send_frame_per_field(
+                const std::vector<MtSymbolRecord> &records,
+                const uint64_t server_timestamp) {
+            std::vector<uint8_t> frame;
+            encode_frame(frame, records, server_timestamp);
+            for(size_t pos = 0; pos < frame.size(); pos += sizeof(uint64_t)) {
+                boost::asio::write(socket, boost::asio::buffer(frame.data() + pos, sizeof(uint64_t)));
+            }
+            bytes_sent += frame.size();
+        }
+
+        /** \brief Дождаться, пока мост закроет соединение
+         *
+         * Данные, которые передает мост, пропускаются
+         * \param timeout_ms Сколько ждать, миллисекунды
+         * \return Вернет true, если мост закрыл соединение
+         */
+        bool wait_closed(const uint32_t timeout_ms) {
+            boost::system::error_code ec;
+            socket.non_blocking(true, ec);
+            if(ec) return false;
+            const std::chrono::steady_clock::time_point stop_time =
+                std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+            uint8_t data[256];
+            while(std::chrono::steady_clock::now() < stop_time) {
+                socket.read_some(boost::asio::buffer(data), ec);
+                if(ec == boost::asio::error::would_block) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                    continue;
+                }
+                if(ec) break;
+            }
+            boost::system::error_code ignored_ec;
+            socket.non_blocking(false, ignored_ec);
+            return ec == boost::asio::error::eof || ec == boost::asio::error::connection_reset;
+        }
+
+        /** \brief Закрыть соединение
+         */
+        void close() {
+            boost::system::error_code ec;
+            socket.shutdown(boost::asio::ip::tcp::socket::shutdown_both, ec);
+            socket.close(ec);
+        }
+    };
+
+    /** \brief Генератор синтетического потока данных советника
+     *
+     * Генератор подключается к MetatraderBridge как советник MT-Bridge.mq4,
+     * передает заголовок соединения, историю и кадры с заданным периодом.
+     * Цены символов меняются случайным блужданием, бары закрываются
+     * при смене минуты времени сервера. Нужен для нагрузочных тестов без терминала
+     */
+    class MtFeedGenerator {
+    private:
+        MtFeeder feeder;
+        std::vector<std::string> symbols;
+        std::vector<MtSymbolRecord> records;
+        std::mt19937 gen;
+        uint32_t hist_len = 0;
+        uint32_t protocol_version = 1;
+        uint64_t server_timestamp = 0;
+        uint64_t frames_sent = 0;
+
+        /** \brief Сделать шаг случайного блуждания
+         * \param timestamp Метка времени сервера
+         */
+        void step(const uint64_t timestamp) {
+            std::uniform_int_distribution<int> move(-3, 3);
+            server_timestamp = timestamp;
+            const uint64_t bar_timestamp = (timestamp / 60) * 60;
+            for(size_t s = 0; s < records.size(); ++s) {
+                MtSymbolRecord &r = records[s];
+                if(r.timestamp != bar_timestamp) {
+                    r.timestamp = bar_timestamp;
+                    r.open = r.high = r.low = r.close;
+                    r.volume = 0;
+                }
+                r.bid += move(gen) * 1e-5;
+                r.ask = r.bid + 1e-4;
+                r.close = r.bid;
+                r.high = std::max(r.high, r.bid);
+                r.low = std::min(r.low, r.bid);
+                ++r.volume;
+            }
+        }
+
+    public:
+        uint32_t time_step_ms = 0;  /**< Шаг времени сервера на кадр в миллисекундах, 0 - время компьютера */
+
+        /** \brief Конструктор генератора
+         * \param host Имя хоста сервера
+         * \param port Номер порта сервера
+         * \param num_symbol Количество символов
+         * \param depth_history Глубина исторических данных
+         * \param version Версия протокола
+         */
+        MtFeedGenerator(
+                const std::string &host,
+                const uint32_t port,
+                const uint32_t num_symbol,
+                const uint32_t depth_history,
+                const uint32_t version = 1) :
+                feeder(host, port), records(num_symbol), gen(1),
+                hist_len(depth_history), protocol_version(version) {
+            for(uint32_t s = 0; s < num_symbol; ++s) {
+                symbols.push_back("SYM" + std::to_string(s));
+                MtSymbolRecord &r = records[s];
+                r.bid = 1.0 + s * 0.001;
+                r.ask = r.bid + 1e-4;
+                r.open = r.high = r.low = r.close = r.bid;
+            }
+        }
+
+        /** \brief Получить имена символов
+         */
+        inline const std::vector<std::string> &get_symbols() const {
+            return symbols;
+        }
+
+        /** \brief Получить записи символов последнего кадра
+         */
+        inline const std::vector<MtSymbolRecord> &get_records() const {
+            return records;
+        }
+
+        /** \brief Получить метку времени сервера последнего кадра
+         */
+        inline uint64_t get_server_timestamp() const {
+            return server_timestamp;
+        }
+
+        inline uint64_t get_frames_sent() const {
+            return frames_sent;
+        }
+
+        inline uint64_t get_bytes_sent() const {
+            return feeder.get_bytes_sent();
+        }
+
+        /** \brief Передать заголовок соединения, исторические данные и первый кадр
+         * \param timestamp Метка времени сервера
+         */
+        void start(const uint64_t timestamp) {
+            server_timestamp = timestamp;
+            feeder.send_handshake(symbols, hist_len, protocol_version);
+            const uint64_t minute = (timestamp / 60) * 60;
+            for(uint32_t h = hist_len; h > 0; --h) {
+                for(size_t s = 0; s < records.size(); ++s) {
+                    MtSymbolRecord &r = records[s];
+                    r.timestamp = minute - h * 60;
+                    r.open = r.high = r.low = r.close = r.bid;
+                    r.volume = 1;
+                }
+                feeder.send_frame(records, timestamp);
+            }
+            /* как и советник, сразу после истории передаем текущий бар */
+            send(timestamp);
+        }
+
+        /** \brief Передать следующий кадр
+         * \param timestamp Метка времени сервера
+         */
+        void send(const uint64_t timestamp) {
+            step(timestamp);
+            if(protocol_version >= MT_BRIDGE_FRAME_VERSION) feeder.send_delta_frame(records, timestamp);
+            else feeder.send_frame(records, timestamp);
+            ++frames_sent;
+        }
+
+        /** \brief Передавать кадры с заданным периодом
+         * \param update_ms Период обновления в миллисекундах, 0 - без пауз
+         * \param num_frames Количество кадров
+         * \param on_frame Функция, которую генератор вызывает после передачи кадра, или nullptr
+         */
+        void run(
+                const uint32_t update_ms,
+                const uint64_t num_frames,
+                std::function<void(const uint64_t frame, const uint64_t timestamp)> on_frame = nullptr) {
+            const std::chrono::steady_clock::time_point start_time = std::chrono::steady_clock::now();
+            const uint64_t start_timestamp = server_timestamp;
+            for(uint64_t f = 1; f <= num_frames; ++f) {
+                if(update_ms > 0) {
+                    std::this_thread::sleep_until(start_time + std::chrono::milliseconds(f * update_ms));
+                }
+                const uint64_t timestamp = time_step_ms > 0 ?
+                    (start_timestamp + (f * time_step_ms) / 1000) : (uint64_t)std::time(nullptr);
+                send(timestamp);
+                if(on_frame != nullptr) on_frame(f, timestamp);
+            }
+        }
+
+        void close() {
+            feeder.close();
+        }
+    };
+};
+
+#endif // METATRADER_BRIDGE_FEEDER_HPP_INCLUDED
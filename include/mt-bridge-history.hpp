@@ -0,0 +1,148 @@
+#ifndef METATRADER_BRIDGE_HISTORY_HPP_INCLUDED
+#define METATRADER_BRIDGE_HISTORY_HPP_INCLUDED
+
+#include <vector>
+#include <string>
+#include <cstdint>
+
+namespace mt_bridge {
+
+    /** \brief Матрица исторических данных (бары x символы)
+     *
+     * Бары лежат на минутной сетке: бар с номером i имеет метку времени
+     * start_timestamp + i * 60. Цены хранятся по столбцам: для каждого символа
+     * open, high, low, close и volume всех баров лежат в памяти подряд,
+     * поэтому столбец можно обрабатывать векторизованным кодом.
+     * Если бара нет (например, выходные), все его значения равны 0
+     */
+    class MtHistoryMatrix {
+    private:
+        static const uint64_t SECONDS_IN_MINUTE = 60;
+
+        std::vector<double> open;
+        std::vector<double> high;
+        std::vector<double> low;
+        std::vector<double> close;
+        std::vector<double> volume;
+        std::vector<std::string> symbol_names;
+        uint64_t start_timestamp = 0;
+        uint32_t num_bars = 0;
+
+    public:
+
+        /** \brief Получить количество баров
+         * \return Количество баров (строк матрицы)
+         */
+        inline uint32_t get_num_bars() const {
+            return num_bars;
+        }
+
+        /** \brief Получить количество символов
+         * \return Количество символов (столбцов матрицы)
+         */
+        inline uint32_t get_num_symbols() const {
+            return symbol_names.size();
+        }
+
+        /** \brief Получить метку времени первого бара
+         * \return Метка времени
+         */
+        inline uint64_t get_start_timestamp() const {
+            return start_timestamp;
+        }
+
+        /** \brief Получить метку времени бара
+         * \param bar_index Номер бара
+         * \return Метка времени
+         */
+        inline uint64_t get_timestamp(const uint32_t bar_index) const {
+            return start_timestamp + bar_index * SECONDS_IN_MINUTE;
+        }
+
+        /** \brief Получить имя символа
+         * \param symbol_index Индекс символа
+         * \return Имя символа
+         */
+        inline const std::string &get_symbol_name(const uint32_t symbol_index) const {
+            return symbol_names[symbol_index];
+        }
+
+        /** \brief Получить таблицу имен символов
+         * \return Имена символов по индексу символа
+         */
+        inline const std::vector<std::string> &get_symbol_names() const {
+            return symbol_names;
+        }
+
+        /* столбцы символа, каждый длиной get_num_bars() */
+
+        inline const double *get_open(const uint32_t symbol_index) const {
+            return open.data() + (size_t)symbol_index * num_bars;
+        }
+
+        inline const double *get_high(const uint32_t symbol_index) const {
+            return high.data() + (size_t)symbol_index * num_bars;
+        }
+
+        inline const double *get_low(const uint32_t symbol_index) const {
+            return low.data() + (size_t)symbol_index * num_bars;
+        }
+
+        inline const double *get_close(const uint32_t symbol_index) const {
+            return close.data() + (size_t)symbol_index * num_bars;
+        }
+
+        inline const double *get_volume(const uint32_t symbol_index) const {
+            return volume.data() + (size_t)symbol_index * num_bars;
+        }
+
+        /** \brief Получить бар
+         * \param symbol_index Индекс символа
+         * \param bar_index Номер бара
+         * \return Бар. Если данных нет, у бара close равен 0
+         */
+        template<class CANDLE_TYPE>
+        CANDLE_TYPE get_candle(const uint32_t symbol_index, const uint32_t bar_index) const {
+            const size_t pos = (size_t)symbol_index * num_bars + bar_index;
+            return CANDLE_TYPE(open[pos], high[pos], low[pos], close[pos], volume[pos], get_timestamp(bar_index));
+        }
+
+        /* методы для заполнения матрицы мостом */
+
+        /** \brief Подготовить матрицу
+         *
+         * Память перераспределяется, только если матрица стала больше
+         * \param names Имена символов
+         * \param timestamp Метка времени первого бара
+         * \param bars Количество баров
+         */
+        void reset(const std::vector<std::string> &names, const uint64_t timestamp, const uint32_t bars) {
+            symbol_names = names;
+            start_timestamp = (timestamp / SECONDS_IN_MINUTE) * SECONDS_IN_MINUTE;
+            num_bars = bars;
+            const size_t size = (size_t)num_bars * symbol_names.size();
+            open.assign(size, 0.0);
+            high.assign(size, 0.0);
+            low.assign(size, 0.0);
+            close.assign(size, 0.0);
+            volume.assign(size, 0.0);
+        }
+
+        /** \brief Записать бар
+         * \param symbol_index Индекс символа
+         * \param bar_index Номер бара
+         * \param candle Бар
+         */
+        template<class CANDLE_TYPE>
+        inline void set_candle(const uint32_t symbol_index, const uint32_t bar_index, const CANDLE_TYPE &candle) {
+            const size_t pos = (size_t)symbol_index * num_bars + bar_index;
+            open[pos] = candle.open;
+            high[pos] = candle.high;
+            low[pos] = candle.low;
+            close[pos] = candle.close;
+            volume[pos] = candle.volume;
+        }
+    };
+};
+
+#endif // METATRADER_BRIDGE_HISTORY_HPP_INCLUDED
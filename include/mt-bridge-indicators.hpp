@@ -0,0 +1,397 @@
+#ifndef METATRADER_BRIDGE_INDICATORS_HPP_INCLUDED
+#define METATRADER_BRIDGE_INDICATORS_HPP_INCLUDED
+
+#include <vector>
+#include <limits>
+#include <cmath>
+#include <algorithm>
+#include <cstdint>
+
+namespace mt_bridge {
+
+    /// Типы индикаторов
+    enum class MtIndicatorType {
+        SMA,        /**< Простая скользящая средняя цены close */
+        EMA,        /**< Экспоненциальная скользящая средняя цены close */
+        RSI,        /**< Индекс относительной силы (сглаживание Уайлдера) */
+        ATR,        /**< Средний истинный диапазон (сглаживание Уайлдера) */
+        BOLLINGER,  /**< Полосы Боллинджера: средняя, верхняя и нижняя полосы */
+    };
+
+    /** \brief Описание индикатора
+     */
+    class MtIndicatorSpec {
+    public:
+        MtIndicatorType type = MtIndicatorType::SMA;
+        uint32_t period = 14;   /**< Период индикатора в барах */
+        double deviation = 2.0; /**< Ширина полос Боллинджера в стандартных отклонениях */
+
+        MtIndicatorSpec() {};
+
+        MtIndicatorSpec(const MtIndicatorType t, const uint32_t p, const double d = 2.0) :
+            type(t), period(std::max(p, (uint32_t)1)), deviation(d) {
+        }
+
+        /** \brief Получить количество значений индикатора
+         * \return 3 для полос Боллинджера, иначе 1
+         */
+        inline uint32_t get_num_outputs() const {
+            return type == MtIndicatorType::BOLLINGER ? 3 : 1;
+        }
+    };
+
+    /** \brief Значения индикаторов всех символов
+     *
+     * Значения одного выхода индикатора лежат в памяти подряд по индексу символа.
+     * Если баров для расчета недостаточно, значение равно NaN
+     */
+    class MtIndicatorValues {
+    private:
+        std::vector<double> values;
+        std::vector<uint32_t> offsets;  /**< Номер первой строки индикатора */
+        uint32_t num_symbols = 0;
+        uint64_t timestamp = 0;
+
+    public:
+
+        /** \brief Задать размеры
+         * \param specs Описания индикаторов
+         * \param symbols Количество символов
+         */
+        void reset(const std::vector<MtIndicatorSpec> &specs, const uint32_t symbols) {
+            offsets.resize(specs.size());
+            uint32_t rows = 0;
+            for(size_t i = 0; i < specs.size(); ++i) {
+                offsets[i] = rows;
+                rows += specs[i].get_num_outputs();
+            }
+            num_symbols = symbols;
+            values.assign((size_t)rows * num_symbols, std::numeric_limits<double>::quiet_NaN());
+        }
+
+        inline uint32_t get_num_indicators() const {
+            return offsets.size();
+        }
+
+        inline uint32_t get_num_symbols() const {
+            return num_symbols;
+        }
+
+        inline uint64_t get_timestamp() const {
+            return timestamp;
+        }
+
+        inline void set_timestamp(const uint64_t t) {
+            timestamp = t;
+        }
+
+        /** \brief Получить значения выхода индикатора всех символов
+         * \param indicator_index Номер индикатора в порядке добавления
+         * \param output Номер выхода (для полос Боллинджера 0 - средняя, 1 - верхняя, 2 - нижняя)
+         * \return Указатель на num_symbols значений
+         */
+        inline double *get_values(const uint32_t indicator_index, const uint32_t output = 0) {
+            return values.data() + (size_t)(offsets[indicator_index] + output) * num_symbols;
+        }
+
+        inline const double *get_values(const uint32_t indicator_index, const uint32_t output = 0) const {
+            return values.data() + (size_t)(offsets[indicator_index] + output) * num_symbols;
+        }
+
+        /** \brief Получить значение индикатора символа
+         * \param indicator_index Номер индикатора в порядке добавления
+         * \param symbol_index Индекс символа
+         * \param output Номер выхода
+         * \return Значение индикатора или NaN
+         */
+        inline double get(const uint32_t indicator_index, const uint32_t symbol_index, const uint32_t output = 0) const {
+            return get_values(indicator_index, output)[symbol_index];
+        }
+    };
+
+    /** \brief Конвейер индикаторов
+     *
+     * Конвейер получает каждое обновление бара M1. Когда приходит бар новее
+     * текущего, текущий бар считается закрытым и учитывается в состоянии
+     * индикаторов за O(1). Несформированный бар в состояние не попадает,
+     * поэтому его повторные обновления ничего не нужно откатывать: он
+     * подставляется в индикаторы только при расчете значений.
+     * Состояние хранится по столбцам (массив на каждое поле, индекс - символ),
+     * поэтому расчет одного индикатора для всех символов - это один цикл
+     * без ветвлений, который компилятор может векторизовать
+     */
+    class MtIndicatorPipeline {
+    private:
+
+        /** \brief Состояние индикатора всех символов
+         */
+        class State {
+        public:
+            MtIndicatorSpec spec;
+            std::vector<double> ring;       /**< Последние period - 1 закрытых цен, по period элементов на символ */
+            std::vector<uint32_t> ring_pos;
+            std::vector<double> sum;        /**< SMA, BOLLINGER: сумма цен в ring */
+            std::vector<double> sum_sq;     /**< BOLLINGER: сумма квадратов цен в ring */
+            std::vector<double> average;    /**< EMA: значение; RSI: средний рост; ATR: значение */
+            std::vector<double> average_loss;   /**< RSI: среднее падение */
+            std::vector<double> count;      /**< Количество закрытых баров в состоянии */
+
+            State(const MtIndicatorSpec &s) : spec(s) {};
+
+            void add_symbol() {
+                ring.resize(ring.size() + spec.period, 0);
+                ring_pos.push_back(0);
+                sum.push_back(0);
+                sum_sq.push_back(0);
+                average.push_back(0);
+                average_loss.push_back(0);
+                count.push_back(0);
+            }
+
+            void reset_symbol(const uint32_t s) {
+                std::fill(ring.begin() + (size_t)s * spec.period, ring.begin() + (size_t)(s + 1) * spec.period, 0.0);
+                ring_pos[s] = 0;
+                sum[s] = sum_sq[s] = average[s] = average_loss[s] = count[s] = 0;
+            }
+        };
+
+        std::vector<State> states;
+        /* текущий (несформированный) бар и последний закрытый бар символов */
+        std::vector<double> close;
+        std::vector<double> high;
+        std::vector<double> low;
+        std::vector<double> prev_close;     /**< Цена close последнего закрытого бара */
+        std::vector<double> has_prev;       /**< 1, если закрытый бар есть */
+        std::vector<uint64_t> timestamp;
+        std::vector<uint8_t> has_current;
+
+        /** \brief Учесть закрытый бар
+         * \param state Состояние индикатора
+         * \param s Индекс символа
+         */
+        void commit(State &state, const uint32_t s) {
+            const uint32_t n = state.spec.period;
+            const double c = close[s];
+            switch(state.spec.type) {
+            case MtIndicatorType::SMA:
+            case MtIndicatorType::BOLLINGER:
+                /* в ring храним n - 1 последних закрытых цен */
+                if(n > 1) {
+                    double &slot = state.ring[(size_t)s * n + state.ring_pos[s]];
+                    if(state.count[s] >= n - 1) {
+                        state.sum[s] -= slot;
+                        state.sum_sq[s] -= slot * slot;
+                    } else {
+                        state.count[s] += 1;
+                    }
+                    slot = c;
+                    state.sum[s] += c;
+                    state.sum_sq[s] += c * c;
+                    state.ring_pos[s] = (state.ring_pos[s] + 1) % (n - 1);
+                }
+                break;
+            case MtIndicatorType::EMA: {
+                    const double alpha = 2.0 / (double)(n + 1);
+                    state.average[s] = state.count[s] == 0 ? c : state.average[s] + alpha * (c - state.average[s]);
+                    state.count[s] += 1;
+                }
+                break;
+            case MtIndicatorType::RSI:
+                if(has_prev[s] != 0) {
+                    const double change = c - prev_close[s];
+                    const double k = std::min(state.count[s], (double)(n - 1));
+                    state.average[s] = (state.average[s] * k + std::max(change, 0.0)) / (k + 1);
+                    state.average_loss[s] = (state.average_loss[s] * k + std::max(-change, 0.0)) / (k + 1);
+                    state.count[s] += 1;
+                }
+                break;
+            case MtIndicatorType::ATR: {
+                    const double range = has_prev[s] != 0 ?
+                        std::max(high[s], prev_close[s]) - std::min(low[s], prev_close[s]) :
+                        high[s] - low[s];
+                    const double k = std::min(state.count[s], (double)(n - 1));
+                    state.average[s] = (state.average[s] * k + range) / (k + 1);
+                    state.count[s] += 1;
+                }
+                break;
+            };
+        }
+
+        /** \brief Рассчитать индикатор всех символов с текущим баром
+         * \param state Состояние индикатора
+         * \param values Значения индикаторов
+         * \param indicator_index Номер индикатора
+         */
+        void evaluate(const State &state, MtIndicatorValues &values, const uint32_t indicator_index) const {
+            const double NaN = std::numeric_limits<double>::quiet_NaN();
+            const uint32_t num_symbols = close.size();
+            const double n = (double)state.spec.period;
+            const double *c = close.data();
+            const double *h = high.data();
+            const double *l = low.data();
+            const double *pc = prev_close.data();
+            const double *hp = has_prev.data();
+            const double *count = state.count.data();
+            const double *sum = state.sum.data();
+            const double *sum_sq = state.sum_sq.data();
+            const double *average = state.average.data();
+            const double *average_loss = state.average_loss.data();
+            double *out = values.get_values(indicator_index);
+            switch(state.spec.type) {
+            case MtIndicatorType::SMA:
+                for(uint32_t s = 0; s < num_symbols; ++s) {
+                    out[s] = count[s] + 1 >= n ? (sum[s] + c[s]) / n : NaN;
+                }
+                break;
+            case MtIndicatorType::BOLLINGER: {
+                    double *upper = values.get_values(indicator_index, 1);
+                    double *lower = values.get_values(indicator_index, 2);
+                    const double deviation = state.spec.deviation;
+                    for(uint32_t s = 0; s < num_symbols; ++s) {
+                        const double mean = (sum[s] + c[s]) / n;
+                        const double variance = std::max((sum_sq[s] + c[s] * c[s]) / n - mean * mean, 0.0);
+                        const double width = deviation * std::sqrt(variance);
+                        const bool is_ready = count[s] + 1 >= n;
+                        out[s] = is_ready ? mean : NaN;
+                        upper[s] = is_ready ? mean + width : NaN;
+                        lower[s] = is_ready ? mean - width : NaN;
+                    }
+                }
+                break;
+            case MtIndicatorType::EMA: {
+                    const double alpha = 2.0 / (n + 1.0);
+                    for(uint32_t s = 0; s < num_symbols; ++s) {
+                        const double ema = count[s] == 0 ? c[s] : average[s] + alpha * (c[s] - average[s]);
+                        out[s] = count[s] + 1 >= n ? ema : NaN;
+                    }
+                }
+                break;
+            case MtIndicatorType::RSI:
+                for(uint32_t s = 0; s < num_symbols; ++s) {
+                    const double change = c[s] - pc[s];
+                    const double k = std::min(count[s], n - 1.0);
+                    const double gain = (average[s] * k + std::max(change, 0.0)) / (k + 1.0);
+                    const double loss = (average_loss[s] * k + std::max(-change, 0.0)) / (k + 1.0);
+                    const double rsi = loss == 0 ? (gain == 0 ? 50.0 : 100.0) : 100.0 - 100.0 / (1.0 + gain / loss);
+                    out[s] = hp[s] != 0 && count[s] + 1 >= n ? rsi : NaN;
+                }
+                break;
+            case MtIndicatorType::ATR:
+                for(uint32_t s = 0; s < num_symbols; ++s) {
+                    const double range = hp[s] != 0 ? std::max(h[s], pc[s]) - std::min(l[s], pc[s]) : h[s] - l[s];
+                    const double k = std::min(count[s], n - 1.0);
+                    out[s] = count[s] + 1 >= n ? (average[s] * k + range) / (k + 1.0) : NaN;
+                }
+                break;
+            };
+        }
+
+    public:
+
+        /** \brief Добавить индикатор
+         *
+         * Индикаторы нужно добавить до первого символа
+         * \param spec Описание индикатора
+         * \return Номер индикатора
+         */
+        uint32_t add(const MtIndicatorSpec &spec) {
+            states.push_back(State(spec));
+            return states.size() - 1;
+        }
+
+        inline bool empty() const {
+            return states.empty();
+        }
+
+        /** \brief Получить описания индикаторов
+         * \return Описания в порядке добавления
+         */
+        std::vector<MtIndicatorSpec> get_specs() const {
+            std::vector<MtIndicatorSpec> specs;
+            for(size_t i = 0; i < states.size(); ++i) {
+                specs.push_back(states[i].spec);
+            }
+            return specs;
+        }
+
+        inline uint32_t get_num_symbols() const {
+            return close.size();
+        }
+
+        /** \brief Добавить символ
+         */
+        void add_symbol() {
+            close.push_back(0);
+            high.push_back(0);
+            low.push_back(0);
+            prev_close.push_back(0);
+            has_prev.push_back(0);
+            timestamp.push_back(0);
+            has_current.push_back(0);
+            for(size_t i = 0; i < states.size(); ++i) {
+                states[i].add_symbol();
+            }
+        }
+
+        /** \brief Начать расчет символа заново (переподключение терминала)
+         * \param s Индекс символа
+         */
+        void reset_symbol(const uint32_t s) {
+            close[s] = high[s] = low[s] = prev_close[s] = has_prev[s] = 0;
+            timestamp[s] = 0;
+            has_current[s] = 0;
+            for(size_t i = 0; i < states.size(); ++i) {
+                states[i].reset_symbol(s);
+            }
+        }
+
+        /** \brief Учесть обновление бара M1
+         *
+         * Бар новее текущего закрывает текущий бар, бар с той же меткой
+         * времени заменяет текущий бар, более старые бары игнорируются
+         * \param s Индекс символа
+         * \param candle Бар
+         */
+        template<class CANDLE_TYPE>
+        void update(const uint32_t s, const CANDLE_TYPE &candle) {
+            if(has_current[s] && candle.timestamp < timestamp[s]) return;
+            if(has_current[s] && candle.timestamp > timestamp[s]) {
+                for(size_t i = 0; i < states.size(); ++i) {
+                    commit(states[i], s);
+                }
+                prev_close[s] = close[s];
+                has_prev[s] = 1;
+            }
+            close[s] = candle.close;
+            high[s] = candle.high;
+            low[s] = candle.low;
+            timestamp[s] = candle.timestamp;
+            has_current[s] = 1;
+        }
+
+        /** \brief Рассчитать значения всех индикаторов всех символов
+         * \param values Значения индикаторов
+         */
+        void evaluate(MtIndicatorValues &values) const {
+            const uint32_t num_symbols = close.size();
+            if(values.get_num_symbols() != num_symbols ||
+                values.get_num_indicators() != states.size()) {
+                values.reset(get_specs(), num_symbols);
+            }
+            for(size_t i = 0; i < states.size(); ++i) {
+                evaluate(states[i], values, i);
+            }
+            /* у символов без баров значений нет */
+            for(size_t i = 0; i < states.size(); ++i) {
+                for(uint32_t output = 0; output < states[i].spec.get_num_outputs(); ++output) {
+                    double *out = values.get_values(i, output);
+                    for(uint32_t s = 0; s < num_symbols; ++s) {
+                        if(!has_current[s]) out[s] = std::numeric_limits<double>::quiet_NaN();
+                    }
+                }
+            }
+        }
+    };
+};
+
+#endif // METATRADER_BRIDGE_INDICATORS_HPP_INCLUDED
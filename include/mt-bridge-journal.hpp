@@ -0,0 +1,341 @@
+#ifndef METATRADER_BRIDGE_JOURNAL_HPP_INCLUDED
+#define METATRADER_BRIDGE_JOURNAL_HPP_INCLUDED
+
+#include <string>
+#include <cstring>
+#include <cstdint>
+
+#if defined(_WIN32)
+/* winsock2.h должен быть подключен раньше windows.h, иначе boost.asio не соберется */
+#include <winsock2.h>
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#endif
+
+namespace mt_bridge {
+
+    /* Журнал баров
+     *
+     * Файл журнала начинается с заголовка MT_BRIDGE_JOURNAL_HEADER_SIZE байт:
+     *
+     * uint32_t magic       - MT_BRIDGE_JOURNAL_MAGIC
+     * uint32_t version     - MT_BRIDGE_JOURNAL_VERSION
+     * uint32_t record_size - MT_BRIDGE_JOURNAL_RECORD_SIZE
+     * uint32_t reserved
+     * uint64_t count       - количество записанных баров
+     *
+     * Далее идут бары по возрастанию метки времени:
+     * double open, double high, double low, double close, double volume, uint64_t timestamp.
+     * Файл растет блоками по MT_BRIDGE_JOURNAL_GROW_RECORDS баров,
+     * количество баров в заголовке обновляется после записи бара
+     */
+
+    const uint32_t MT_BRIDGE_JOURNAL_MAGIC = 0x4A42544D;        /**< Сигнатура журнала, "MTBJ" */
+    const uint32_t MT_BRIDGE_JOURNAL_VERSION = 1;
+    const size_t MT_BRIDGE_JOURNAL_HEADER_SIZE = 64;
+    const size_t MT_BRIDGE_JOURNAL_RECORD_SIZE = 48;
+    const size_t MT_BRIDGE_JOURNAL_GROW_RECORDS = 4096;
+
+    /** \brief Файл, отображенный в память
+     */
+    class MtMappedFile {
+    private:
+#if defined(_WIN32)
+        HANDLE file = INVALID_HANDLE_VALUE;
+        HANDLE mapping = NULL;
+#else
+        int file = -1;
+#endif
+        uint8_t *data = nullptr;
+        uint64_t size = 0;
+
+        void unmap() {
+            if(data == nullptr) return;
+#if defined(_WIN32)
+            UnmapViewOfFile(data);
+            CloseHandle(mapping);
+            mapping = NULL;
+#else
+            munmap(data, size);
+#endif
+            data = nullptr;
+        }
+
+        bool map(const uint64_t new_size) {
+#if defined(_WIN32)
+            /* отображение сам увеличивает файл до нужного размера */
+            mapping = CreateFileMappingA(file, NULL, PAGE_READWRITE,
+                (DWORD)(new_size >> 32), (DWORD)(new_size & 0xFFFFFFFF), NULL);
+            if(mapping == NULL) return false;
+            data = (uint8_t*)MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, (SIZE_T)new_size);
+            if(data == nullptr) {
+                CloseHandle(mapping);
+                mapping = NULL;
+                return false;
+            }
+#else
+            if(new_size > size && ftruncate(file, (off_t)new_size) != 0) return false;
+            void *ptr = mmap(NULL, (size_t)new_size, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+            if(ptr == MAP_FAILED) return false;
+            data = (uint8_t*)ptr;
+#endif
+            size = new_size;
+            return true;
+        }
+
+    public:
+
+        MtMappedFile() {};
+
+        MtMappedFile(const MtMappedFile &) = delete;
+        MtMappedFile &operator=(const MtMappedFile &) = delete;
+
+        ~MtMappedFile() {
+            close();
+        }
+
+        /** \brief Открыть или создать файл и отобразить его в память
+         * \param path Путь к файлу
+         * \param min_size Минимальный размер файла, меньший файл будет увеличен
+         * \return Вернет true, если файл открыт
+         */
+        bool open(const std::string &path, const uint64_t min_size) {
+            close();
+#if defined(_WIN32)
+            file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ,
+                NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+            if(file == INVALID_HANDLE_VALUE) return false;
+            LARGE_INTEGER file_size;
+            if(!GetFileSizeEx(file, &file_size)) {
+                close();
+                return false;
+            }
+            const uint64_t current_size = (uint64_t)file_size.QuadPart;
+#else
+            file = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+            if(file < 0) return false;
+            struct stat st;
+            if(fstat(file, &st) != 0) {
+                close();
+                return false;
+            }
+            const uint64_t current_size = (uint64_t)st.st_size;
+#endif
+            size = current_size;
+            if(!map(current_size > min_size ? current_size : min_size)) {
+                close();
+                return false;
+            }
+            return true;
+        }
+
+        /** \brief Увеличить файл
+         *
+         * После вызова указатель на данные меняется
+         * \param new_size Новый размер файла
+         * \return Вернет true, если файл увеличен
+         */
+        bool grow(const uint64_t new_size) {
+            if(new_size <= size) return true;
+            unmap();
+            return map(new_size);
+        }
+
+        void close() {
+            unmap();
+#if defined(_WIN32)
+            if(file != INVALID_HANDLE_VALUE) CloseHandle(file);
+            file = INVALID_HANDLE_VALUE;
+#else
+            if(file >= 0) ::close(file);
+            file = -1;
+#endif
+            size = 0;
+        }
+
+        inline bool is_open() const {
+            return data != nullptr;
+        }
+
+        inline uint8_t *get_data() {
+            return data;
+        }
+
+        inline const uint8_t *get_data() const {
+            return data;
+        }
+
+        inline uint64_t get_size() const {
+            return size;
+        }
+    };
+
+    /** \brief Создать папку, если ее нет
+     * \param path Путь к папке
+     * \return Вернет true, если папка есть или создана
+     */
+    inline bool create_directory(const std::string &path) {
+#if defined(_WIN32)
+        if(CreateDirectoryA(path.c_str(), NULL)) return true;
+        return GetLastError() == ERROR_ALREADY_EXISTS;
+#else
+        if(mkdir(path.c_str(), 0755) == 0) return true;
+        return errno == EEXIST;
+#endif
+    }
+
+    /** \brief Журнал закрытых баров символа
+     *
+     * Журнал только дописывается и хранится в файле, отображенном в память,
+     * поэтому запись бара стоит одного копирования в память, а после
+     * перезапуска программы бары можно загрузить без передачи истории
+     */
+    class MtCandleJournal {
+    private:
+        MtMappedFile file;
+        uint64_t count = 0;
+        uint64_t capacity = 0;
+        uint64_t last_timestamp = 0;
+
+        inline uint8_t *get_record(const uint64_t index) {
+            return file.get_data() + MT_BRIDGE_JOURNAL_HEADER_SIZE + index * MT_BRIDGE_JOURNAL_RECORD_SIZE;
+        }
+
+        inline const uint8_t *get_record(const uint64_t index) const {
+            return file.get_data() + MT_BRIDGE_JOURNAL_HEADER_SIZE + index * MT_BRIDGE_JOURNAL_RECORD_SIZE;
+        }
+
+        inline void write_count() {
+            std::memcpy(file.get_data() + 16, &count, sizeof(uint64_t));
+        }
+
+    public:
+
+        /** \brief Получить имя файла журнала для символа
+         *
+         * Символы, которые нельзя использовать в имени файла, заменяются на '_'
+         * \param path Папка журнала
+         * \param symbol_name Имя символа
+         * \return Путь к файлу журнала
+         */
+        static std::string get_file_name(const std::string &path, const std::string &symbol_name) {
+            std::string name(symbol_name);
+            for(size_t i = 0; i < name.size(); ++i) {
+                const char c = name[i];
+                if((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+                    (c >= '0' && c <= '9') || c == '.' || c == '-' || c == '_') continue;
+                name[i] = '_';
+            }
+            if(path.empty()) return name + ".mtbj";
+            const char last = path[path.size() - 1];
+            if(last == '/' || last == '\\') return path + name + ".mtbj";
+            return path + "/" + name + ".mtbj";
+        }
+
+        /** \brief Открыть или создать журнал
+         * \param file_name Путь к файлу журнала
+         * \return Вернет true, если журнал открыт. Файл с другим форматом не перезаписывается
+         */
+        bool open(const std::string &file_name) {
+            count = 0;
+            capacity = 0;
+            last_timestamp = 0;
+            if(!file.open(file_name, MT_BRIDGE_JOURNAL_HEADER_SIZE +
+                MT_BRIDGE_JOURNAL_GROW_RECORDS * MT_BRIDGE_JOURNAL_RECORD_SIZE)) return false;
+            uint8_t *data = file.get_data();
+            uint32_t header[4];
+            std::memcpy(header, data, sizeof(header));
+            if(header[0] == 0) {
+                /* новый файл */
+                header[0] = MT_BRIDGE_JOURNAL_MAGIC;
+                header[1] = MT_BRIDGE_JOURNAL_VERSION;
+                header[2] = MT_BRIDGE_JOURNAL_RECORD_SIZE;
+                header[3] = 0;
+                std::memcpy(data, header, sizeof(header));
+                write_count();
+            } else
+            if(header[0] != MT_BRIDGE_JOURNAL_MAGIC ||
+                header[1] != MT_BRIDGE_JOURNAL_VERSION ||
+                header[2] != MT_BRIDGE_JOURNAL_RECORD_SIZE) {
+                file.close();
+                return false;
+            }
+            capacity = (file.get_size() - MT_BRIDGE_JOURNAL_HEADER_SIZE) / MT_BRIDGE_JOURNAL_RECORD_SIZE;
+            std::memcpy(&count, data + 16, sizeof(uint64_t));
+            if(count > capacity) count = capacity;
+            if(count > 0) std::memcpy(&last_timestamp, get_record(count - 1) + 40, sizeof(uint64_t));
+            return true;
+        }
+
+        inline void close() {
+            file.close();
+        }
+
+        inline bool is_open() const {
+            return file.is_open();
+        }
+
+        /** \brief Получить количество баров в журнале
+         */
+        inline uint64_t size() const {
+            return count;
+        }
+
+        /** \brief Получить метку времени последнего бара
+         * \return Метка времени или 0, если журнал пуст
+         */
+        inline uint64_t get_last_timestamp() const {
+            return last_timestamp;
+        }
+
+        /** \brief Дописать бар
+         *
+         * Бар записывается, только если он новее последнего бара журнала
+         * \param candle Бар
+         * \return Вернет true, если бар записан
+         */
+        template<class CANDLE_TYPE>
+        bool append(const CANDLE_TYPE &candle) {
+            if(!file.is_open() || candle.timestamp <= last_timestamp) return false;
+            if(count == capacity) {
+                const uint64_t new_capacity = capacity + MT_BRIDGE_JOURNAL_GROW_RECORDS;
+                if(!file.grow(MT_BRIDGE_JOURNAL_HEADER_SIZE + new_capacity * MT_BRIDGE_JOURNAL_RECORD_SIZE)) {
+                    file.close();
+                    return false;
+                }
+                capacity = new_capacity;
+            }
+            const double values[5] = {candle.open, candle.high, candle.low, candle.close, (double)candle.volume};
+            const uint64_t timestamp = candle.timestamp;
+            uint8_t *record = get_record(count);
+            std::memcpy(record, values, sizeof(values));
+            std::memcpy(record + 40, &timestamp, sizeof(uint64_t));
+            ++count;
+            write_count();
+            last_timestamp = timestamp;
+            return true;
+        }
+
+        /** \brief Получить бар
+         * \param index Номер бара в журнале
+         * \return Бар
+         */
+        template<class CANDLE_TYPE>
+        CANDLE_TYPE get_candle(const uint64_t index) const {
+            double values[5];
+            uint64_t timestamp = 0;
+            const uint8_t *record = get_record(index);
+            std::memcpy(values, record, sizeof(values));
+            std::memcpy(&timestamp, record + 40, sizeof(uint64_t));
+            return CANDLE_TYPE(values[0], values[1], values[2], values[3], values[4], timestamp);
+        }
+    };
+};
+
+#endif // METATRADER_BRIDGE_JOURNAL_HPP_INCLUDED
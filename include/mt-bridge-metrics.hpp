@@ -0,0 +1,177 @@
+#ifndef METATRADER_BRIDGE_METRICS_HPP_INCLUDED
+#define METATRADER_BRIDGE_METRICS_HPP_INCLUDED
+
+#include <atomic>
+#include <array>
+#include <chrono>
+#include <cstdint>
+
+namespace mt_bridge {
+
+    /** \brief Статистика задержки этапа
+     *
+     * Все времена в микросекундах. Перцентили берутся по верхней границе
+     * корзины гистограммы, погрешность не больше 1/16 значения
+     */
+    class MtLatencyStats {
+    public:
+        uint64_t count = 0;     /**< Количество замеров */
+        double min = 0;
+        double max = 0;
+        double mean = 0;
+        double p50 = 0;
+        double p90 = 0;
+        double p99 = 0;
+        double p999 = 0;
+    };
+
+    /** \brief Гистограмма задержек без блокировок
+     *
+     * Корзины устроены как в HDR-гистограмме: значения до 32 нс хранятся
+     * точно, далее каждая степень двойки делится на 16 корзин.
+     * Запись стоит нескольких атомарных сложений, писать и читать
+     * гистограмму могут любые потоки одновременно
+     */
+    class MtLatencyHistogram {
+    private:
+        static const uint32_t SUB_BUCKET_BITS = 4;
+        static const uint64_t SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+        static const size_t NUM_BUCKETS = (64 - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+        std::array<std::atomic<uint64_t>, NUM_BUCKETS> buckets;
+        std::atomic<uint64_t> count;
+        std::atomic<uint64_t> sum;
+        std::atomic<uint64_t> min;
+        std::atomic<uint64_t> max;
+
+        static inline uint32_t get_msb(const uint64_t value) {
+#if defined(__GNUC__)
+            return 63 - __builtin_clzll(value);
+#else
+            uint32_t msb = 0;
+            uint64_t v = value;
+            while(v >>= 1) ++msb;
+            return msb;
+#endif
+        }
+
+        static inline size_t get_bucket_index(const uint64_t value) {
+            if(value < 2 * SUB_BUCKETS) return (size_t)value;
+            const uint32_t shift = get_msb(value) - SUB_BUCKET_BITS;
+            return (size_t)((shift + 1) * SUB_BUCKETS + ((value >> shift) - SUB_BUCKETS));
+        }
+
+        static inline uint64_t get_bucket_upper_bound(const size_t index) {
+            if(index < 2 * SUB_BUCKETS) return index;
+            const uint32_t shift = (uint32_t)(index / SUB_BUCKETS) - 1;
+            const uint64_t sub_bucket = index % SUB_BUCKETS + SUB_BUCKETS;
+            return ((sub_bucket + 1) << shift) - 1;
+        }
+
+    public:
+
+        MtLatencyHistogram() {
+            reset();
+        }
+
+        MtLatencyHistogram(const MtLatencyHistogram &) = delete;
+        MtLatencyHistogram &operator=(const MtLatencyHistogram &) = delete;
+
+        /** \brief Записать задержку
+         * \param ns Задержка в наносекундах
+         */
+        inline void record(const uint64_t ns) {
+            buckets[get_bucket_index(ns)].fetch_add(1, std::memory_order_relaxed);
+            count.fetch_add(1, std::memory_order_relaxed);
+            sum.fetch_add(ns, std::memory_order_relaxed);
+            uint64_t current = min.load(std::memory_order_relaxed);
+            while(ns < current && !min.compare_exchange_weak(current, ns, std::memory_order_relaxed));
+            current = max.load(std::memory_order_relaxed);
+            while(ns > current && !max.compare_exchange_weak(current, ns, std::memory_order_relaxed));
+        }
+
+        /** \brief Записать задержку между двумя моментами времени
+         * \param start Начало этапа
+         * \param stop Конец этапа
+         */
+        inline void record(
+                const std::chrono::steady_clock::time_point &start,
+                const std::chrono::steady_clock::time_point &stop) {
+            const int64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start).count();
+            record(ns > 0 ? (uint64_t)ns : 0);
+        }
+
+        /** \brief Получить статистику
+         *
+         * Если в это время идет запись, статистика может не учесть последние замеры
+         * \return Статистика задержки
+         */
+        MtLatencyStats get_stats() const {
+            MtLatencyStats stats;
+            std::array<uint64_t, NUM_BUCKETS> counts;
+            uint64_t total = 0;
+            for(size_t i = 0; i < NUM_BUCKETS; ++i) {
+                counts[i] = buckets[i].load(std::memory_order_relaxed);
+                total += counts[i];
+            }
+            if(total == 0) return stats;
+            const double NS_IN_US = 1000.0;
+            const uint64_t max_ns = max.load(std::memory_order_relaxed);
+            stats.count = total;
+            stats.min = (double)min.load(std::memory_order_relaxed) / NS_IN_US;
+            stats.max = (double)max_ns / NS_IN_US;
+            stats.mean = (double)sum.load(std::memory_order_relaxed) /
+                (double)count.load(std::memory_order_relaxed) / NS_IN_US;
+
+            const double percentiles[4] = {0.5, 0.9, 0.99, 0.999};
+            double *values[4] = {&stats.p50, &stats.p90, &stats.p99, &stats.p999};
+            size_t p = 0;
+            uint64_t accumulated = 0;
+            for(size_t i = 0; i < NUM_BUCKETS && p < 4; ++i) {
+                accumulated += counts[i];
+                while(p < 4 && (double)accumulated >= percentiles[p] * (double)total) {
+                    const uint64_t upper_bound = get_bucket_upper_bound(i);
+                    *values[p] = (double)(upper_bound < max_ns ? upper_bound : max_ns) / NS_IN_US;
+                    ++p;
+                }
+            }
+            return stats;
+        }
+
+        /** \brief Очистить гистограмму
+         */
+        void reset() {
+            for(size_t i = 0; i < NUM_BUCKETS; ++i) {
+                buckets[i].store(0, std::memory_order_relaxed);
+            }
+            count.store(0, std::memory_order_relaxed);
+            sum.store(0, std::memory_order_relaxed);
+            min.store(UINT64_MAX, std::memory_order_relaxed);
+            max.store(0, std::memory_order_relaxed);
+        }
+    };
+
+    /** \brief Снимок метрик моста
+     *
+     * Этапы прохождения кадра измеряются по монотонным часам:
+     * получение байтов из сокета, конец декодирования кадра,
+     * обновление хранилища баров, вход в callback и выход из него
+     */
+    class MtMetrics {
+    public:
+        uint64_t frames = 0;        /**< Количество кадров данных */
+        uint64_t bytes = 0;         /**< Количество полученных и разобранных байтов */
+        uint64_t connections = 0;   /**< Количество установленных соединений с терминалами */
+        uint64_t reconnects = 0;    /**< Количество повторных соединений терминалов */
+        uint64_t callbacks = 0;     /**< Количество событий NEW_TICK */
+        uint64_t resumes = 0;       /**< Количество повторных соединений, при которых данные символов сохранены */
+        MtLatencyStats receive_to_decode;   /**< От получения байтов из сокета до конца декодирования кадра */
+        MtLatencyStats decode_to_store;     /**< От конца декодирования кадра до обновления хранилища баров */
+        MtLatencyStats store_to_callback;   /**< От обновления хранилища баров до входа в callback */
+        MtLatencyStats callback;            /**< Время работы callback */
+        MtLatencyStats lock_wait;           /**< Ожидание блокировки баров потоком чтения */
+        MtLatencyStats reconnect_gap;       /**< От разрыва соединения терминала до восстановления потока данных */
+    };
+};
+
+#endif // METATRADER_BRIDGE_METRICS_HPP_INCLUDED
@@ -0,0 +1,249 @@
+#ifndef METATRADER_BRIDGE_OFFSET_HPP_INCLUDED
+#define METATRADER_BRIDGE_OFFSET_HPP_INCLUDED
+
+#include <array>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+namespace mt_bridge {
+
+    /** \brief Модель смещения времени сервера относительно времени компьютера
+     *
+     * Смещение меняется линейно: offset + drift * (pc_time - reference_time)
+     */
+    class MtOffsetModel {
+    public:
+        double offset = 0;          /**< Смещение в момент reference_time, секунды */
+        double drift = 0;           /**< Уход часов сервера относительно часов компьютера, секунд в секунду */
+        double reference_time = 0;  /**< Время компьютера, к которому привязано смещение */
+        double uncertainty = 1.0;   /**< Оценка погрешности смещения, секунды */
+
+        /** \brief Получить смещение
+         * \param pc_time Время компьютера
+         * \return Смещение времени сервера, секунды
+         */
+        inline double get_offset(const double pc_time) const {
+            return offset + drift * (pc_time - reference_time);
+        }
+    };
+
+    /** \brief Оценщик смещения времени сервера
+     *
+     * Оценщик получает метку времени сервера кадров терминала, в которых
+     * она сменилась, и время компьютера, когда кадр был получен. Методы
+     * вызывает только поток чтения соединения терминала
+     */
+    class MtOffsetEstimator {
+    public:
+
+        virtual ~MtOffsetEstimator() {};
+
+        /** \brief Начать оценку заново (новое соединение)
+         */
+        virtual void reset() = 0;
+
+        /** \brief Учесть кадр
+         * \param server_timestamp Метка времени сервера из кадра, целые секунды
+         * \param pc_time Время компьютера в момент получения кадра
+         */
+        virtual void update(const uint64_t server_timestamp, const double pc_time) = 0;
+
+        /** \brief Получить модель смещения
+         * \return Модель смещения
+         */
+        virtual MtOffsetModel get_model() const = 0;
+    };
+
+    /** \brief Скользящее среднее смещения за 256 смен секунды сервера
+     *
+     * Прежний способ оценки. Метка времени сервера имеет разрешение в секунду,
+     * поэтому оценка смещена на величину до секунды
+     */
+    class MtAverageOffsetEstimator : public MtOffsetEstimator {
+    private:
+        static const uint32_t ARRAY_SIZE = 256;
+        std::array<double, ARRAY_SIZE> array_offset;
+        uint8_t index_array_offset = 0;
+        uint32_t count = 0;
+        double sum = 0;
+        uint64_t last_server_timestamp = 0;
+        MtOffsetModel model;
+
+    public:
+
+        void reset() override {
+            index_array_offset = 0;
+            count = 0;
+            sum = 0;
+            last_server_timestamp = 0;
+            model = MtOffsetModel();
+        }
+
+        void update(const uint64_t server_timestamp, const double pc_time) override {
+            if(server_timestamp == last_server_timestamp) return;
+            last_server_timestamp = server_timestamp;
+            const double offset = (double)server_timestamp - pc_time;
+            if(count != ARRAY_SIZE) {
+                array_offset[index_array_offset++] = offset;
+                count = index_array_offset == 0 ? ARRAY_SIZE : index_array_offset;
+                sum += offset;
+            } else {
+                sum += offset - array_offset[index_array_offset];
+                array_offset[index_array_offset++] = offset;
+            }
+            model.offset = sum / (double)count;
+            model.reference_time = pc_time;
+            model.uncertainty = 1.0;
+        }
+
+        MtOffsetModel get_model() const override {
+            return model;
+        }
+    };
+
+    /** \brief Оценка смещения по смене секунды сервера
+     *
+     * Метка времени сервера кадра (TimeCurrent) - это время последнего тика,
+     * поэтому в момент, когда впервые пришел кадр с новой секундой S, время
+     * сервера уже не меньше S. Каждая смена секунды дает нижнюю границу
+     * смещения S - pc_time, которая меньше истинного смещения на задержку
+     * тика и кадра. Оценщик берет верхнюю огибающую границ за последние
+     * WINDOW_SIZE смен секунды: максимумы в BLOCKS блоках окна, через которые
+     * проводится прямая, ее наклон - уход часов сервера. Граница выше прямой
+     * больше чем на OUTLIER_THRESHOLD отбрасывается, если таких границ
+     * MAX_OUTLIERS подряд, считаем, что часы переведены, и начинаем оценку заново.
+     * Погрешность - разброс максимумов блоков вокруг прямой
+     */
+    class MtEdgeOffsetEstimator : public MtOffsetEstimator {
+    private:
+        static const size_t WINDOW_SIZE = 256;
+        static const size_t BLOCKS = 8;
+        static const uint32_t MAX_OUTLIERS = 3;
+        const double OUTLIER_THRESHOLD = 0.25;      /**< Секунды */
+        const double MIN_DRIFT_PERIOD = 30.0;       /**< Уход часов оценивается по окну не короче, секунды */
+        const double MAX_DRIFT = 0.001;             /**< Уход часов больше 1000 ppm считаем ошибкой */
+        const double MIN_UNCERTAINTY = 0.001;
+
+        std::array<double, WINDOW_SIZE> sample_time;
+        std::array<double, WINDOW_SIZE> sample_offset;
+        size_t index_sample = 0;
+        size_t count = 0;
+        uint32_t num_outliers = 0;
+        bool is_init = false;
+        uint64_t last_server_timestamp = 0;
+        MtOffsetModel model;
+
+        /** \brief Провести прямую через верхнюю огибающую границ
+         */
+        void fit() {
+            const size_t first = count < WINDOW_SIZE ? 0 : index_sample;
+            double last_time = sample_time[(first + count - 1) % WINDOW_SIZE];
+            if(count < BLOCKS) {
+                double max_offset = sample_offset[first];
+                for(size_t i = 1; i < count; ++i) {
+                    max_offset = std::max(max_offset, sample_offset[(first + i) % WINDOW_SIZE]);
+                }
+                model.offset = max_offset;
+                model.drift = 0;
+                model.reference_time = last_time;
+                model.uncertainty = 0.5;
+                return;
+            }
+
+            /* максимумы блоков в хронологическом порядке */
+            std::array<double, BLOCKS> block_time;
+            std::array<double, BLOCKS> block_offset;
+            for(size_t b = 0; b < BLOCKS; ++b) {
+                const size_t begin = b * count / BLOCKS;
+                const size_t end = (b + 1) * count / BLOCKS;
+                size_t best = (first + begin) % WINDOW_SIZE;
+                for(size_t i = begin + 1; i < end; ++i) {
+                    const size_t index = (first + i) % WINDOW_SIZE;
+                    if(sample_offset[index] > sample_offset[best]) best = index;
+                }
+                block_time[b] = sample_time[best];
+                block_offset[b] = sample_offset[best];
+            }
+
+            /* наклон по методу наименьших квадратов */
+            double drift = 0;
+            if((last_time - sample_time[first]) >= MIN_DRIFT_PERIOD) {
+                double mean_time = 0, mean_offset = 0;
+                for(size_t b = 0; b < BLOCKS; ++b) {
+                    mean_time += block_time[b];
+                    mean_offset += block_offset[b];
+                }
+                mean_time /= (double)BLOCKS;
+                mean_offset /= (double)BLOCKS;
+                double sxy = 0, sxx = 0;
+                for(size_t b = 0; b < BLOCKS; ++b) {
+                    sxy += (block_time[b] - mean_time) * (block_offset[b] - mean_offset);
+                    sxx += (block_time[b] - mean_time) * (block_time[b] - mean_time);
+                }
+                if(sxx > 0) drift = std::max(-MAX_DRIFT, std::min(MAX_DRIFT, sxy / sxx));
+            }
+
+            /* прямая проходит не ниже максимумов блоков */
+            double offset = -HUGE_VAL;
+            for(size_t b = 0; b < BLOCKS; ++b) {
+                offset = std::max(offset, block_offset[b] + drift * (last_time - block_time[b]));
+            }
+            double uncertainty = MIN_UNCERTAINTY;
+            for(size_t b = 0; b < BLOCKS; ++b) {
+                uncertainty = std::max(uncertainty, offset - (block_offset[b] + drift * (last_time - block_time[b])));
+            }
+            model.offset = offset;
+            model.drift = drift;
+            model.reference_time = last_time;
+            model.uncertainty = uncertainty;
+        }
+
+    public:
+
+        void reset() override {
+            index_sample = 0;
+            count = 0;
+            num_outliers = 0;
+            is_init = false;
+            last_server_timestamp = 0;
+            model = MtOffsetModel();
+        }
+
+        void update(const uint64_t server_timestamp, const double pc_time) override {
+            if(!is_init || server_timestamp < last_server_timestamp) {
+                /* до первой смены секунды знаем только, что время сервера внутри секунды */
+                reset();
+                is_init = true;
+                last_server_timestamp = server_timestamp;
+                model.offset = (double)server_timestamp - pc_time + 0.5;
+                model.reference_time = pc_time;
+                model.uncertainty = 0.5;
+                return;
+            }
+            if(server_timestamp == last_server_timestamp) return;
+            last_server_timestamp = server_timestamp;
+
+            const double offset = (double)server_timestamp - pc_time;
+            if(count >= BLOCKS && offset > model.get_offset(pc_time) + OUTLIER_THRESHOLD) {
+                if(++num_outliers < MAX_OUTLIERS) return;
+                /* часы переведены, старые границы больше не верны */
+                count = 0;
+                index_sample = 0;
+            }
+            num_outliers = 0;
+
+            sample_time[index_sample] = pc_time;
+            sample_offset[index_sample] = offset;
+            index_sample = (index_sample + 1) % WINDOW_SIZE;
+            if(count < WINDOW_SIZE) ++count;
+            fit();
+        }
+
+        MtOffsetModel get_model() const override {
+            return model;
+        }
+    };
+};
+
+#endif // METATRADER_BRIDGE_OFFSET_HPP_INCLUDED
@@ -0,0 +1,202 @@
+#ifndef METATRADER_BRIDGE_PROTOCOL_HPP_INCLUDED
+#define METATRADER_BRIDGE_PROTOCOL_HPP_INCLUDED
+
+#include "mt-bridge-buffer.hpp"
+#include <vector>
+#include <cstring>
+#include <cstdint>
+
+namespace mt_bridge {
+
+    /* Протокол версии 2
+     *
+     * Все данные передаются кадрами. Каждый кадр начинается с заголовка
+     * MT_BRIDGE_FRAME_HEADER_SIZE байт:
+     *
+     * uint32_t magic       - MT_BRIDGE_FRAME_MAGIC
+     * uint16_t version     - версия протокола
+     * uint16_t type        - тип кадра MtFrameType
+     * uint32_t sequence    - номер кадра, начиная с 0, каждый следующий кадр на 1 больше
+     * uint32_t length      - размер данных кадра после заголовка
+     *
+     * Первый кадр соединения - HANDSHAKE: uint32_t num_symbol, имена символов
+     * по MT_BRIDGE_SYMBOL_NAME_SIZE байт, uint32_t hist_len и необязательное
+     * поле uint32_t flags. Если в flags установлен флаг MT_BRIDGE_HANDSHAKE_HISTORY_REQUEST,
+     * советник ждет от моста кадр HISTORY_REQUEST с uint32_t количеством баров
+     * истории (не больше hist_len) и передает только эти бары.
+     * Если в flags установлен флаг MT_BRIDGE_HANDSHAKE_SESSION_ID, за flags
+     * идет uint64_t session_id - идентификатор сессии советника, который
+     * не меняется при переподключении. Если тот же терминал переподключился
+     * с той же сессией и тем же списком символов, мост сохраняет данные
+     * символов и просит передать только пропущенные бары.
+     * Если в flags установлен флаг MT_BRIDGE_HANDSHAKE_TERMINAL_NAME, далее
+     * идет char[32] имя терминала, за которым мост закрепляет слот терминала.
+     * Кадры моста нумеруются независимо от кадров советника.
+     * Далее идут кадры SNAPSHOT, данные которых совпадают с кадром версии 1,
+     * и кадры DELTA, которые передают только изменившиеся поля символов:
+     *
+     * uint64_t server_timestamp    - метка времени сервера
+     * uint8_t bitmap[(num_symbol + 7) / 8] - битовая карта изменившихся символов
+     * для каждого изменившегося символа по порядку:
+     *     uint8_t field_mask       - битовая карта изменившихся полей записи символа
+     *                                (бит 0 - bid, ..., бит 7 - timestamp)
+     *     8 байт на каждое изменившееся поле по порядку
+     *
+     * Изменения считаются относительно последнего принятого кадра,
+     * поэтому первым кадром данных после HANDSHAKE должен быть SNAPSHOT.
+     *
+     * Советник версии 1 начинает соединение с uint32_t версии, а советник
+     * версии 2 - с MT_BRIDGE_FRAME_MAGIC, так мост отличает версии протокола.
+     *
+     * Теми же кадрами мост передает данные подписчикам ретрансляции
+     * (MtRebroadcastServer). Подписчик только читает, кадры нумеруются
+     * для каждого подписчика с 0:
+     *
+     * SYMBOL - uint32_t symbol_index, имя символа MT_BRIDGE_SYMBOL_NAME_SIZE байт
+     * UPDATE - uint32_t symbol_index, uint32_t reserved, double bid, ask, open,
+     *          high, low, close, volume, uint64_t server_timestamp, uint64_t timestamp
+     */
+
+    const uint32_t MT_BRIDGE_FRAME_MAGIC = 0x3242544D;          /**< Сигнатура кадра, "MTB2" */
+    const uint16_t MT_BRIDGE_FRAME_VERSION = 2;                 /**< Версия протокола с кадрами */
+    const size_t MT_BRIDGE_FRAME_HEADER_SIZE = 16;              /**< Размер заголовка кадра */
+    const uint32_t MT_BRIDGE_MAX_FRAME_LENGTH = 64 * 1024 * 1024;   /**< Максимальный размер данных кадра */
+    const size_t MT_BRIDGE_SYMBOL_RECORD_FIELDS = 8;            /**< Количество полей записи символа */
+    const uint32_t MT_BRIDGE_HANDSHAKE_HISTORY_REQUEST = 0x01;  /**< Флаг HANDSHAKE: советник ждет кадр HISTORY_REQUEST */
+    const uint32_t MT_BRIDGE_HANDSHAKE_SESSION_ID = 0x02;       /**< Флаг HANDSHAKE: за флагами идет uint64_t session_id */
+    const uint32_t MT_BRIDGE_HANDSHAKE_TERMINAL_NAME = 0x04;    /**< Флаг HANDSHAKE: далее идет char[32] имя терминала */
+    const size_t MT_BRIDGE_SYMBOL_FRAME_SIZE = 4 + MT_BRIDGE_SYMBOL_NAME_SIZE;  /**< Размер данных кадра SYMBOL */
+    const size_t MT_BRIDGE_UPDATE_FRAME_SIZE = 80;              /**< Размер данных кадра UPDATE */
+
+    /// Типы кадров
+    enum class MtFrameType {
+        HANDSHAKE = 1,  /**< Заголовок соединения: символы и глубина истории */
+        SNAPSHOT = 2,   /**< Полный кадр данных всех символов */
+        DELTA = 3,      /**< Кадр только с изменившимися полями символов */
+        HISTORY_REQUEST = 4,    /**< Кадр моста: сколько баров истории передать */
+        SYMBOL = 5,     /**< Кадр ретрансляции: индекс и имя символа */
+        UPDATE = 6,     /**< Кадр ретрансляции: последнее состояние символа */
+    };
+
+
+    /** \brief Заголовок кадра
+     */
+    class MtFrameHeader {
+    public:
+        uint32_t magic;
+        uint16_t version;
+        uint16_t type;
+        uint32_t sequence;
+        uint32_t length;
+
+        MtFrameHeader() :
+            magic(MT_BRIDGE_FRAME_MAGIC), version(MT_BRIDGE_FRAME_VERSION),
+            type(0), sequence(0), length(0) {
+        }
+
+        MtFrameHeader(const MtFrameType t, const uint32_t s, const uint32_t l) :
+            magic(MT_BRIDGE_FRAME_MAGIC), version(MT_BRIDGE_FRAME_VERSION),
+            type((uint16_t)t), sequence(s), length(l) {
+        }
+    };
+
+    /** \brief Декодировать заголовок кадра
+     * \param data Указатель на начало заголовка (MT_BRIDGE_FRAME_HEADER_SIZE байт)
+     * \param header Заголовок кадра
+     */
+    inline void decode_frame_header(const uint8_t *data, MtFrameHeader &header) {
+        header.magic = decode_value<uint32_t>(data);
+        header.version = decode_value<uint16_t>(data + 4);
+        header.type = decode_value<uint16_t>(data + 6);
+        header.sequence = decode_value<uint32_t>(data + 8);
+        header.length = decode_value<uint32_t>(data + 12);
+    }
+
+    /** \brief Дописать заголовок кадра в массив байтов
+     * \param buffer Массив байтов
+     * \param header Заголовок кадра
+     */
+    inline void encode_frame_header(std::vector<uint8_t> &buffer, const MtFrameHeader &header) {
+        const size_t pos = buffer.size();
+        buffer.resize(pos + MT_BRIDGE_FRAME_HEADER_SIZE);
+        uint8_t *data = buffer.data() + pos;
+        std::memcpy(data, &header.magic, 4);
+        std::memcpy(data + 4, &header.version, 2);
+        std::memcpy(data + 6, &header.type, 2);
+        std::memcpy(data + 8, &header.sequence, 4);
+        std::memcpy(data + 12, &header.length, 4);
+    }
+
+    /** \brief Получить размер битовой карты символов кадра DELTA
+     * \param num_symbol Количество символов
+     * \return Размер в байтах
+     */
+    inline size_t get_delta_bitmap_size(const uint32_t num_symbol) {
+        return ((size_t)num_symbol + 7) / 8;
+    }
+
+    /** \brief Получить минимальный размер кадра DELTA (без изменившихся символов)
+     * \param num_symbol Количество символов
+     * \return Размер в байтах
+     */
+    inline size_t get_min_delta_frame_size(const uint32_t num_symbol) {
+        return MT_BRIDGE_SERVER_TIMESTAMP_SIZE + get_delta_bitmap_size(num_symbol);
+    }
+
+    /** \brief Получить максимальный размер кадра DELTA (изменились все поля всех символов)
+     * \param num_symbol Количество символов
+     * \return Размер в байтах
+     */
+    inline size_t get_max_delta_frame_size(const uint32_t num_symbol) {
+        return get_min_delta_frame_size(num_symbol) +
+            (size_t)num_symbol * (1 + MT_BRIDGE_SYMBOL_RECORD_SIZE);
+    }
+
+    /** \brief Применить кадр DELTA к записям символов
+     * \param data Данные кадра
+     * \param length Размер данных кадра
+     * \param records Записи символов из последнего кадра, в них будут записаны изменения
+     * \param changed_symbols Номера изменившихся символов
+     * \return Метка времени сервера
+     */
+    inline uint64_t decode_delta_frame(
+            const uint8_t *data,
+            const size_t length,
+            std::vector<MtSymbolRecord> &records,
+            std::vector<uint32_t> &changed_symbols) {
+        const uint32_t num_symbol = records.size();
+        if(length < get_min_delta_frame_size(num_symbol))
+            throw("Error! Invalid delta frame length");
+        const uint64_t server_timestamp = decode_value<uint64_t>(data);
+        const uint8_t *bitmap = data + MT_BRIDGE_SERVER_TIMESTAMP_SIZE;
+        const uint8_t *pos = bitmap + get_delta_bitmap_size(num_symbol);
+        const uint8_t *end = data + length;
+        changed_symbols.clear();
+        for(uint32_t s = 0; s < num_symbol; ++s) {
+            if((bitmap[s / 8] & (1 << (s % 8))) == 0) continue;
+            if(pos >= end) throw("Error! Invalid delta frame length");
+            const uint8_t field_mask = *pos++;
+            MtSymbolRecord &record = records[s];
+            for(size_t f = 0; f < MT_BRIDGE_SYMBOL_RECORD_FIELDS; ++f) {
+                if((field_mask & (1 << f)) == 0) continue;
+                if(pos + sizeof(uint64_t) > end) throw("Error! Invalid delta frame length");
+                switch(f) {
+                case 0: record.bid = decode_value<double>(pos); break;
+                case 1: record.ask = decode_value<double>(pos); break;
+                case 2: record.open = decode_value<double>(pos); break;
+                case 3: record.high = decode_value<double>(pos); break;
+                case 4: record.low = decode_value<double>(pos); break;
+                case 5: record.close = decode_value<double>(pos); break;
+                case 6: record.volume = decode_value<uint64_t>(pos); break;
+                case 7: record.timestamp = decode_value<uint64_t>(pos); break;
+                };
+                pos += sizeof(uint64_t);
+            }
+            changed_symbols.push_back(s);
+        }
+        if(pos != end) throw("Error! Invalid delta frame length");
+        return server_timestamp;
+    }
+};
+
+#endif // METATRADER_BRIDGE_PROTOCOL_HPP_INCLUDED
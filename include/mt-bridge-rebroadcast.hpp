@@ -0,0 +1,411 @@
+#ifndef METATRADER_BRIDGE_REBROADCAST_HPP_INCLUDED
+#define METATRADER_BRIDGE_REBROADCAST_HPP_INCLUDED
+
+#include "mt-bridge-protocol.hpp"
+#include "mt-bridge-shm.hpp"
+#include <boost/asio.hpp>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <chrono>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+
+namespace mt_bridge {
+
+    /** \brief Закодировать кадр SYMBOL
+     * \param buffer Массив байтов, в конец которого дописывается кадр
+     * \param sequence Номер кадра
+     * \param symbol_index Индекс символа
+     * \param symbol_name Имя символа
+     */
+    inline void encode_symbol_frame(
+            std::vector<uint8_t> &buffer,
+            const uint32_t sequence,
+            const uint32_t symbol_index,
+            const std::string &symbol_name) {
+        encode_frame_header(buffer, MtFrameHeader(MtFrameType::SYMBOL, sequence, MT_BRIDGE_SYMBOL_FRAME_SIZE));
+        const size_t pos = buffer.size();
+        buffer.resize(pos + MT_BRIDGE_SYMBOL_FRAME_SIZE, 0);
+        uint8_t *data = buffer.data() + pos;
+        std::memcpy(data, &symbol_index, 4);
+        std::memcpy(data + 4, symbol_name.c_str(), std::min(symbol_name.size(), MT_BRIDGE_SYMBOL_NAME_SIZE));
+    }
+
+    /** \brief Закодировать кадр UPDATE
+     * \param buffer Массив байтов, в конец которого дописывается кадр
+     * \param sequence Номер кадра
+     * \param message Состояние символа
+     */
+    inline void encode_update_frame(
+            std::vector<uint8_t> &buffer,
+            const uint32_t sequence,
+            const MtShmMessage &message) {
+        encode_frame_header(buffer, MtFrameHeader(MtFrameType::UPDATE, sequence, MT_BRIDGE_UPDATE_FRAME_SIZE));
+        const size_t pos = buffer.size();
+        buffer.resize(pos + MT_BRIDGE_UPDATE_FRAME_SIZE, 0);
+        uint8_t *data = buffer.data() + pos;
+        std::memcpy(data, &message.symbol_index, 4);
+        std::memcpy(data + 8, &message.bid, 8);
+        std::memcpy(data + 16, &message.ask, 8);
+        std::memcpy(data + 24, &message.open, 8);
+        std::memcpy(data + 32, &message.high, 8);
+        std::memcpy(data + 40, &message.low, 8);
+        std::memcpy(data + 48, &message.close, 8);
+        std::memcpy(data + 56, &message.volume, 8);
+        std::memcpy(data + 64, &message.server_timestamp, 8);
+        std::memcpy(data + 72, &message.timestamp, 8);
+    }
+
+    /** \brief Декодировать данные кадра UPDATE
+     * \param data Данные кадра (MT_BRIDGE_UPDATE_FRAME_SIZE байт)
+     * \param message Состояние символа
+     */
+    inline void decode_update_frame(const uint8_t *data, MtShmMessage &message) {
+        message.event = MtShmEvent::UPDATE;
+        message.symbol_index = decode_value<uint32_t>(data);
+        message.bid = decode_value<double>(data + 8);
+        message.ask = decode_value<double>(data + 16);
+        message.open = decode_value<double>(data + 24);
+        message.high = decode_value<double>(data + 32);
+        message.low = decode_value<double>(data + 40);
+        message.close = decode_value<double>(data + 48);
+        message.volume = decode_value<double>(data + 56);
+        message.server_timestamp = decode_value<uint64_t>(data + 64);
+        message.timestamp = decode_value<uint64_t>(data + 72);
+    }
+
+    /** \brief Счетчики подписчика ретрансляции
+     */
+    class MtRebroadcastStats {
+    public:
+        std::string address;    /**< Адрес и порт подписчика */
+        uint64_t sent = 0;      /**< Количество переданных кадров UPDATE */
+        uint64_t dropped = 0;   /**< Количество состояний символов, замененных более новыми до передачи */
+        uint64_t queued = 0;    /**< Количество состояний, которые ждут передачи */
+        uint64_t max_queued = 0;
+        double lag = 0;         /**< Сколько секунд ждет передачи самое старое состояние */
+        double max_lag = 0;     /**< Максимальное время от публикации состояния до конца его передачи, секунды */
+        bool is_conflated = false;  /**< Очередь переполнена, подписчик получает только последние состояния символов */
+    };
+
+    /** \brief Сервер ретрансляции состояний символов
+     *
+     * Сервер работает в пуле потоков ввода-вывода моста. Метод publish
+     * только кладет состояние в очереди подписчиков и никогда не ждет сеть.
+     * Все операции с сокетом подписчика идут через strand подписчика,
+     * поэтому пул может состоять из нескольких потоков.
+     * У каждого подписчика очередь ограничена queue_size состояниями.
+     * Если очередь переполнена, подписчик переходит в режим слияния:
+     * для каждого символа хранится только последнее состояние, а замененные
+     * состояния учитываются в счетчике dropped. Так медленный подписчик
+     * не задерживает прием данных и не расходует память без ограничения
+     */
+    class MtRebroadcastServer {
+    private:
+        typedef boost::asio::ip::tcp tcp;
+        typedef std::chrono::steady_clock::time_point time_point;
+        typedef boost::asio::strand<boost::asio::io_context::executor_type> strand;
+
+        class Item {
+        public:
+            MtShmMessage message;
+            time_point publish_time;
+        };
+
+        /** \brief Подписчик
+         */
+        class Subscriber : public std::enable_shared_from_this<Subscriber> {
+        public:
+            MtRebroadcastServer *server;
+            strand socket_strand;   /**< Порядок операций с сокетом */
+            tcp::socket socket;
+            std::string address;
+            /* очередь состояний (кольцо фиксированного размера) */
+            std::vector<Item> queue;
+            size_t queue_begin = 0;
+            size_t queue_size = 0;
+            /* последние состояния символов в режиме слияния */
+            std::vector<Item> latest;
+            std::vector<uint8_t> is_latest;
+            std::vector<uint32_t> latest_symbols;
+            /* символы, имена которых нужно передать */
+            std::vector<uint32_t> new_symbols;
+            /* передача */
+            std::vector<uint8_t> write_buffer;
+            uint32_t write_sequence = 0;
+            bool is_writing = false;
+            bool is_closed = false;
+            time_point write_time;  /**< Время публикации самого старого состояния в передаче */
+            MtRebroadcastStats stats;
+
+            Subscriber(MtRebroadcastServer *s, boost::asio::io_context &context, tcp::socket sock, const size_t capacity) :
+                server(s), socket_strand(context.get_executor()), socket(std::move(sock)), queue(std::max(capacity, (size_t)1)) {
+                boost::system::error_code ec;
+                const tcp::endpoint endpoint = socket.remote_endpoint(ec);
+                if(!ec) address = endpoint.address().to_string() + ":" + std::to_string(endpoint.port());
+                stats.address = address;
+            }
+
+            inline bool has_data() const {
+                return queue_size != 0 || !latest_symbols.empty() || !new_symbols.empty();
+            }
+
+            /** \brief Положить состояние в очередь
+             *
+             * Вызывается под блокировкой сервера
+             */
+            void push(const MtShmMessage &message, const time_point &publish_time) {
+                /* пока есть слитые состояния, все новые состояния сливаются,
+                 * чтобы не передать старое состояние символа после нового
+                 */
+                if(latest_symbols.empty() && queue_size < queue.size()) {
+                    Item &item = queue[(queue_begin + queue_size) % queue.size()];
+                    item.message = message;
+                    item.publish_time = publish_time;
+                    ++queue_size;
+                } else {
+                    const uint32_t s = message.symbol_index;
+                    if(s >= latest.size()) {
+                        latest.resize(s + 1);
+                        is_latest.resize(s + 1, 0);
+                    }
+                    if(is_latest[s]) {
+                        /* время публикации остается временем первого слитого состояния */
+                        latest[s].message = message;
+                        ++stats.dropped;
+                    } else {
+                        latest[s].message = message;
+                        latest[s].publish_time = publish_time;
+                        is_latest[s] = 1;
+                        latest_symbols.push_back(s);
+                    }
+                    stats.is_conflated = true;
+                }
+                stats.queued = queue_size + latest_symbols.size();
+                stats.max_queued = std::max(stats.max_queued, stats.queued);
+            }
+
+            /** \brief Начать передачу, если она еще не идет
+             *
+             * Вызывается под блокировкой сервера из любого потока,
+             * сама передача начинается в strand подписчика
+             */
+            void write() {
+                if(is_writing || is_closed || !has_data()) return;
+                write_buffer.clear();
+                write_time = time_point::max();
+                for(size_t i = 0; i < new_symbols.size(); ++i) {
+                    const uint32_t s = new_symbols[i];
+                    encode_symbol_frame(write_buffer, write_sequence++, s, server->symbols[s]);
+                }
+                new_symbols.clear();
+                for(size_t i = 0; i < queue_size; ++i) {
+                    const Item &item = queue[(queue_begin + i) % queue.size()];
+                    encode_update_frame(write_buffer, write_sequence++, item.message);
+                    write_time = std::min(write_time, item.publish_time);
+                }
+                stats.sent += queue_size;
+                queue_begin = 0;
+                queue_size = 0;
+                for(size_t i = 0; i < latest_symbols.size(); ++i) {
+                    const Item &item = latest[latest_symbols[i]];
+                    encode_update_frame(write_buffer, write_sequence++, item.message);
+                    write_time = std::min(write_time, item.publish_time);
+                    is_latest[latest_symbols[i]] = 0;
+                }
+                stats.sent += latest_symbols.size();
+                latest_symbols.clear();
+                stats.is_conflated = false;
+                stats.queued = 0;
+                is_writing = true;
+
+                auto self(this->shared_from_this());
+                boost::asio::dispatch(socket_strand, [this, self]() {
+                    boost::asio::async_write(socket, boost::asio::buffer(write_buffer),
+                            boost::asio::bind_executor(socket_strand,
+                            [this, self](const boost::system::error_code &ec, std::size_t /*bytes*/) {
+                        std::lock_guard<std::mutex> lock(server->mutex);
+                        is_writing = false;
+                        if(ec) {
+                            if(ec != boost::asio::error::operation_aborted && !is_closed) {
+                                std::cerr << "mt-bridge rebroadcast error: " << ec.message() << std::endl;
+                            }
+                            server->remove(self);
+                            return;
+                        }
+                        if(write_time != time_point::max()) {
+                            stats.max_lag = std::max(stats.max_lag,
+                                std::chrono::duration<double>(std::chrono::steady_clock::now() - write_time).count());
+                        }
+                        write();
+                    }));
+                });
+            }
+
+            /** \brief Следить за закрытием соединения подписчиком
+             *
+             * Вызывается в strand подписчика
+             */
+            void read() {
+                auto self(this->shared_from_this());
+                socket.async_read_some(boost::asio::buffer(read_buffer),
+                        boost::asio::bind_executor(socket_strand,
+                        [this, self](const boost::system::error_code &ec, std::size_t /*bytes*/) {
+                    std::lock_guard<std::mutex> lock(server->mutex);
+                    if(!ec) {
+                        if(!is_closed) read();
+                        return;
+                    }
+                    server->remove(self);
+                }));
+            }
+
+            uint8_t read_buffer[256];
+        };
+
+        boost::asio::io_context &io_context;
+        tcp::acceptor acceptor;
+        size_t queue_size;
+        std::mutex mutex;
+        std::vector<std::shared_ptr<Subscriber>> subscribers;
+        std::vector<std::string> symbols;       /**< Имена символов по индексу */
+        std::vector<MtShmMessage> last;         /**< Последние состояния символов */
+        std::vector<uint8_t> is_last;
+
+        /** \brief Удалить подписчика
+         *
+         * Вызывается под блокировкой сервера, сокет закрывается в strand подписчика
+         */
+        void remove(const std::shared_ptr<Subscriber> &subscriber) {
+            if(subscriber->is_closed) return;
+            subscriber->is_closed = true;
+            boost::asio::dispatch(subscriber->socket_strand, [subscriber]() {
+                boost::system::error_code ignored_ec;
+                subscriber->socket.close(ignored_ec);
+            });
+            subscribers.erase(std::remove(subscribers.begin(), subscribers.end(), subscriber), subscribers.end());
+        }
+
+        void start_accept() {
+            acceptor.async_accept([this](const boost::system::error_code &ec, tcp::socket socket) {
+                if(ec == boost::asio::error::operation_aborted) return;
+                if(!ec) {
+                    socket.set_option(tcp::no_delay(true));
+                    auto subscriber = std::make_shared<Subscriber>(this, io_context, std::move(socket), queue_size);
+                    std::lock_guard<std::mutex> lock(mutex);
+                    /* новый подписчик сразу получает имена и последние состояния всех символов */
+                    const time_point now = std::chrono::steady_clock::now();
+                    for(uint32_t s = 0; s < symbols.size(); ++s) {
+                        subscriber->new_symbols.push_back(s);
+                    }
+                    for(uint32_t s = 0; s < last.size(); ++s) {
+                        if(is_last[s]) subscriber->push(last[s], now);
+                    }
+                    subscribers.push_back(subscriber);
+                    boost::asio::dispatch(subscriber->socket_strand, [subscriber]() {
+                        subscriber->read();
+                    });
+                    subscriber->write();
+                } else {
+                    std::cerr << "mt-bridge rebroadcast error: " << ec.message() << std::endl;
+                }
+                start_accept();
+            });
+        }
+
+    public:
+
+        /** \brief Конструктор сервера
+         * \param context Контекст ввода-вывода моста
+         * \param address Адрес, например "127.0.0.1"
+         * \param port Номер порта
+         * \param subscriber_queue_size Емкость очереди каждого подписчика
+         */
+        MtRebroadcastServer(
+                boost::asio::io_context &context,
+                const std::string &address,
+                const uint32_t port,
+                const size_t subscriber_queue_size) :
+                io_context(context),
+                acceptor(context, tcp::endpoint(boost::asio::ip::make_address(address), port)),
+                queue_size(subscriber_queue_size) {
+            start_accept();
+        }
+
+        MtRebroadcastServer(const MtRebroadcastServer &) = delete;
+        MtRebroadcastServer &operator=(const MtRebroadcastServer &) = delete;
+
+        ~MtRebroadcastServer() {
+            close();
+        }
+
+        /** \brief Закрыть порт и соединения подписчиков
+         */
+        void close() {
+            boost::system::error_code ignored_ec;
+            acceptor.close(ignored_ec);
+            std::lock_guard<std::mutex> lock(mutex);
+            while(!subscribers.empty()) {
+                remove(subscribers.back());
+            }
+        }
+
+        /** \brief Добавить символ
+         * \param symbol_index Индекс символа
+         * \param symbol_name Имя символа
+         */
+        void add_symbol(const uint32_t symbol_index, const std::string &symbol_name) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if(symbol_index >= symbols.size()) symbols.resize(symbol_index + 1);
+            symbols[symbol_index] = symbol_name;
+            for(size_t i = 0; i < subscribers.size(); ++i) {
+                subscribers[i]->new_symbols.push_back(symbol_index);
+                subscribers[i]->write();
+            }
+        }
+
+        /** \brief Опубликовать состояние символа
+         *
+         * Метод не ждет передачи данных
+         * \param message Состояние символа
+         */
+        void publish(const MtShmMessage &message) {
+            const time_point now = std::chrono::steady_clock::now();
+            std::lock_guard<std::mutex> lock(mutex);
+            const uint32_t s = message.symbol_index;
+            if(s >= last.size()) {
+                last.resize(s + 1);
+                is_last.resize(s + 1, 0);
+            }
+            last[s] = message;
+            is_last[s] = 1;
+            for(size_t i = 0; i < subscribers.size(); ++i) {
+                subscribers[i]->push(message, now);
+                subscribers[i]->write();
+            }
+        }
+
+        /** \brief Получить счетчики подписчиков
+         * \return Счетчики подключенных подписчиков
+         */
+        std::vector<MtRebroadcastStats> get_stats() {
+            std::vector<MtRebroadcastStats> stats;
+            const time_point now = std::chrono::steady_clock::now();
+            std::lock_guard<std::mutex> lock(mutex);
+            for(size_t i = 0; i < subscribers.size(); ++i) {
+                const Subscriber &subscriber = *subscribers[i];
+                stats.push_back(subscriber.stats);
+                if(subscriber.is_writing && subscriber.write_time != time_point::max()) {
+                    stats.back().lag = std::chrono::duration<double>(now - subscriber.write_time).count();
+                }
+            }
+            return stats;
+        }
+    };
+};
+
+#endif // METATRADER_BRIDGE_REBROADCAST_HPP_INCLUDED
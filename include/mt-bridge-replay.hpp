@@ -0,0 +1,225 @@
+#ifndef METATRADER_BRIDGE_REPLAY_HPP_INCLUDED
+#define METATRADER_BRIDGE_REPLAY_HPP_INCLUDED
+
+#include "mt-bridge-buffer.hpp"
+#include <boost/asio.hpp>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <thread>
+#include <chrono>
+#include <functional>
+#include <cstring>
+#include <cstdint>
+
+namespace mt_bridge {
+
+    /* Запись потока байтов соединения
+     *
+     * Файл начинается с заголовка:
+     *
+     * uint32_t magic       - MT_BRIDGE_WIRE_MAGIC
+     * uint32_t version     - MT_BRIDGE_WIRE_VERSION
+     *
+     * Далее идут блоки в том виде, в котором их вернул сокет:
+     *
+     * uint64_t receive_time    - время получения блока в микросекундах UTC
+     * uint32_t length          - размер блока
+     * uint8_t data[length]     - байты блока
+     */
+
+    const uint32_t MT_BRIDGE_WIRE_MAGIC = 0x5242544D;   /**< Сигнатура записи, "MTBR" */
+    const uint32_t MT_BRIDGE_WIRE_VERSION = 1;
+    const size_t MT_BRIDGE_WIRE_CHUNK_HEADER_SIZE = 12;
+
+    /** \brief Запись потока байтов соединения в файл
+     *
+     * Блоки, записанные до открытия файла, копятся в памяти и попадают
+     * в файл при открытии: имя файла становится известно только после
+     * заголовка соединения
+     */
+    class MtWireRecorder {
+    private:
+        std::ofstream file;
+        std::string pending;    /**< Блоки, записанные до открытия файла */
+
+    public:
+
+        /** \brief Открыть файл записи
+         * \param file_name Имя файла
+         * \return Вернет true, если файл открыт
+         */
+        bool open(const std::string &file_name) {
+            file.open(file_name, std::ios::binary | std::ios::trunc);
+            if(!file.is_open()) return false;
+            const uint32_t header[2] = {MT_BRIDGE_WIRE_MAGIC, MT_BRIDGE_WIRE_VERSION};
+            file.write((const char*)header, sizeof(header));
+            file.write(pending.data(), pending.size());
+            pending.clear();
+            return file.good();
+        }
+
+        inline bool is_open() const {
+            return file.is_open();
+        }
+
+        /** \brief Записать блок
+         * \param receive_time Время получения блока в секундах с дробной частью
+         * \param data Байты блока
+         * \param length Размер блока
+         */
+        void write(const double receive_time, const uint8_t *data, const size_t length) {
+            uint8_t header[MT_BRIDGE_WIRE_CHUNK_HEADER_SIZE];
+            const uint64_t time_us = (uint64_t)(receive_time * 1000000.0 + 0.5);
+            const uint32_t len = length;
+            std::memcpy(header, &time_us, sizeof(uint64_t));
+            std::memcpy(header + sizeof(uint64_t), &len, sizeof(uint32_t));
+            if(!file.is_open()) {
+                pending.append((const char*)header, sizeof(header));
+                pending.append((const char*)data, length);
+                return;
+            }
+            file.write((const char*)header, sizeof(header));
+            file.write((const char*)data, length);
+        }
+
+        void close() {
+            file.close();
+        }
+    };
+
+    /** \brief Чтение записи потока байтов
+     */
+    class MtWireReader {
+    private:
+        std::ifstream file;
+
+    public:
+
+        /** \brief Открыть файл записи
+         * \param file_name Имя файла
+         * \return Вернет true, если файл открыт и это запись потока байтов
+         */
+        bool open(const std::string &file_name) {
+            file.open(file_name, std::ios::binary);
+            if(!file.is_open()) return false;
+            uint32_t header[2] = {0, 0};
+            file.read((char*)header, sizeof(header));
+            return file.good() &&
+                header[0] == MT_BRIDGE_WIRE_MAGIC &&
+                header[1] == MT_BRIDGE_WIRE_VERSION;
+        }
+
+        /** \brief Прочитать следующий блок
+         * \param receive_time Время получения блока в секундах с дробной частью
+         * \param data Байты блока
+         * \return Вернет false, если блоков больше нет
+         */
+        bool read(double &receive_time, std::vector<uint8_t> &data) {
+            uint8_t header[MT_BRIDGE_WIRE_CHUNK_HEADER_SIZE];
+            if(!file.read((char*)header, sizeof(header))) return false;
+            const uint64_t time_us = decode_value<uint64_t>(header);
+            const uint32_t length = decode_value<uint32_t>(header + sizeof(uint64_t));
+            receive_time = (double)time_us / 1000000.0;
+            data.resize(length);
+            if(length == 0) return true;
+            return (bool)file.read((char*)data.data(), length);
+        }
+
+        void close() {
+            file.close();
+        }
+    };
+
+    /** \brief Заменитель терминала, который воспроизводит запись потока байтов
+     *
+     * Класс подключается к порту MetatraderBridge и передает блоки записи
+     * в реальном времени, в N раз быстрее или без пауз.
+     * Чтобы ускоренное воспроизведение дало ту же последовательность событий,
+     * что и в реальном времени, мосту нужно задать часы MtReplayClock,
+     * переводить их в on_time и задать get_processed и is_idle
+     */
+    class MtReplayer {
+    private:
+        boost::asio::io_context io_context;
+        boost::asio::ip::tcp::socket socket;
+
+        /** \brief Подождать, пока мост разберет переданные байты и обработает события
+         *
+         * Если мост закрыл соединение, байты так и не будут разобраны,
+         * поэтому ждем не больше секунды
+         * \param processed_base Сколько байтов мост разобрал до начала воспроизведения
+         * \param bytes_sent Количество переданных байтов
+         */
+        void wait_processed(const uint64_t processed_base, const uint64_t bytes_sent) {
+            const std::chrono::steady_clock::time_point wait_start = std::chrono::steady_clock::now();
+            while((get_processed != nullptr && (get_processed() - processed_base) < bytes_sent) ||
+                (is_idle != nullptr && !is_idle())) {
+                if((std::chrono::steady_clock::now() - wait_start) > std::chrono::seconds(1)) return;
+                std::this_thread::yield();
+            }
+        }
+
+    public:
+        std::function<void(const double receive_time)> on_time = nullptr;   /**< Вызывается перед передачей блока со временем его получения */
+        std::function<uint64_t()> get_processed = nullptr;  /**< Сколько байтов разобрал мост, например MetatraderBridge::get_bytes_processed */
+        std::function<bool()> is_idle = nullptr;            /**< Мост обработал все события, например MetatraderBridge::is_idle */
+
+        /** \brief Конструктор заменителя терминала
+         * \param host Имя хоста сервера
+         * \param port Номер порта сервера
+         */
+        MtReplayer(const std::string &host, const uint32_t port) :
+                socket(io_context) {
+            boost::asio::ip::tcp::resolver resolver(io_context);
+            boost::asio::connect(socket, resolver.resolve(host, std::to_string(port)));
+            socket.set_option(boost::asio::ip::tcp::no_delay(true));
+        }
+
+        /** \brief Воспроизвести запись
+         * \param file_name Имя файла записи
+         * \param speed Скорость воспроизведения, 1 - реальное время, 0 - без пауз
+         * \return Количество переданных байтов
+         */
+        uint64_t replay(const std::string &file_name, const double speed = 1.0) {
+            MtWireReader reader;
+            if(!reader.open(file_name)) throw("Error! Invalid wire record file");
+            const uint64_t processed_base = get_processed != nullptr ? get_processed() : 0;
+            const std::chrono::steady_clock::time_point start_time = std::chrono::steady_clock::now();
+            std::vector<uint8_t> data;
+            double receive_time = 0;
+            double first_receive_time = 0;
+            bool is_first = true;
+            uint64_t bytes_sent = 0;
+            while(reader.read(receive_time, data)) {
+                if(is_first) {
+                    first_receive_time = receive_time;
+                    is_first = false;
+                }
+                if(speed > 0) {
+                    const double delay = (receive_time - first_receive_time) / speed;
+                    std::this_thread::sleep_until(start_time +
+                        std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                            std::chrono::duration<double>(delay)));
+                }
+                /* часы переводятся только после того, как мост разобрал предыдущий блок */
+                wait_processed(processed_base, bytes_sent);
+                if(on_time != nullptr) on_time(receive_time);
+                boost::asio::write(socket, boost::asio::buffer(data));
+                bytes_sent += data.size();
+            }
+            wait_processed(processed_base, bytes_sent);
+            return bytes_sent;
+        }
+
+        /** \brief Закрыть соединение
+         */
+        void close() {
+            boost::system::error_code ec;
+            socket.shutdown(boost::asio::ip::tcp::socket::shutdown_both, ec);
+            socket.close(ec);
+        }
+    };
+};
+
+#endif // METATRADER_BRIDGE_REPLAY_HPP_INCLUDED
@@ -0,0 +1,174 @@
+#ifndef METATRADER_BRIDGE_SEQLOCK_HPP_INCLUDED
+#define METATRADER_BRIDGE_SEQLOCK_HPP_INCLUDED
+
+#include <atomic>
+#include <array>
+#include <cstring>
+#include <cstdint>
+#include <type_traits>
+#include <stdexcept>
+#include <new>
+
+namespace mt_bridge {
+
+    /** \brief Тик символа
+     */
+    class MtTick {
+    public:
+        double bid;
+        double ask;
+        uint64_t timestamp;
+
+        MtTick() : bid(0), ask(0), timestamp(0) {};
+
+        MtTick(const double _bid, const double _ask, const uint64_t _timestamp) :
+            bid(_bid), ask(_ask), timestamp(_timestamp) {
+        }
+    };
+
+    /** \brief Запись с последовательной блокировкой (seqlock)
+     *
+     * Писатель один, читателей сколько угодно. Читатель никогда не блокируется:
+     * он повторяет чтение, если во время копирования данных шла запись.
+     * Данные хранятся в атомарных словах, поэтому гонки данных нет.
+     * Размер записи кратен строке кэша, но сама запись не выравнивается:
+     * соседние записи не делят строку кэша, только если массив записей
+     * выровнен по строке кэша (так размещают записи MtStableArray и MtShmPublisher)
+     */
+    template<class T>
+    class MtSeqlock {
+    private:
+        static const size_t NUM_WORDS = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+        static const size_t CACHE_LINE_SIZE = 64;
+        static const size_t WORDS_PER_LINE = CACHE_LINE_SIZE / sizeof(uint64_t);
+        /* счетчик вместе с выравниванием занимает одно слово, лишние слова дополняют запись до целых строк кэша */
+        static const size_t NUM_LINE_WORDS = (NUM_WORDS + WORDS_PER_LINE) / WORDS_PER_LINE * WORDS_PER_LINE - 1;
+
+        std::atomic<uint32_t> sequence;
+        std::array<std::atomic<uint64_t>, NUM_LINE_WORDS> words;
+
+    public:
+
+        MtSeqlock() {
+            sequence.store(0, std::memory_order_relaxed);
+            for(size_t i = 0; i < NUM_WORDS; ++i) {
+                words[i].store(0, std::memory_order_relaxed);
+            }
+        }
+
+        /** \brief Записать значение
+         *
+         * Метод может вызывать только один поток одновременно
+         * \param value Значение
+         */
+        void store(const T &value) {
+            uint64_t data[NUM_WORDS] = {};
+            std::memcpy(data, &value, sizeof(T));
+            const uint32_t seq = sequence.load(std::memory_order_relaxed);
+            sequence.store(seq + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            for(size_t i = 0; i < NUM_WORDS; ++i) {
+                words[i].store(data[i], std::memory_order_relaxed);
+            }
+            sequence.store(seq + 2, std::memory_order_release);
+        }
+
+        /** \brief Прочитать значение
+         * \return Согласованная копия значения
+         */
+        T load() const {
+            uint64_t data[NUM_WORDS];
+            while(true) {
+                const uint32_t seq_begin = sequence.load(std::memory_order_acquire);
+                if(seq_begin & 1) continue;
+                for(size_t i = 0; i < NUM_WORDS; ++i) {
+                    data[i] = words[i].load(std::memory_order_relaxed);
+                }
+                std::atomic_thread_fence(std::memory_order_acquire);
+                const uint32_t seq_end = sequence.load(std::memory_order_relaxed);
+                if(seq_begin == seq_end) break;
+            }
+            T value;
+            std::memcpy(&value, data, sizeof(T));
+            return value;
+        }
+    };
+
+    /** \brief Массив со стабильными адресами элементов
+     *
+     * Массив растет блоками и никогда не перемещает элементы,
+     * поэтому читатели могут обращаться к элементам без блокировки,
+     * пока писатель добавляет новые. Блоки выровнены по строке кэша
+     */
+    template<class T, size_t CHUNK_SIZE = 256, size_t MAX_CHUNKS = 4096>
+    class MtStableArray {
+    private:
+        static const size_t CACHE_LINE_SIZE = 64;
+
+        std::array<std::atomic<T*>, MAX_CHUNKS> chunks;
+        std::array<void*, MAX_CHUNKS> blocks;   /**< Память блоков до выравнивания (только для писателя) */
+        std::atomic<size_t> array_size;
+
+    public:
+
+        MtStableArray() {
+            for(size_t i = 0; i < MAX_CHUNKS; ++i) {
+                chunks[i].store(nullptr, std::memory_order_relaxed);
+                blocks[i] = nullptr;
+            }
+            array_size.store(0, std::memory_order_relaxed);
+        }
+
+        ~MtStableArray() {
+            for(size_t i = 0; i < MAX_CHUNKS; ++i) {
+                T *chunk = chunks[i].load(std::memory_order_relaxed);
+                if(chunk == nullptr) continue;
+                for(size_t j = 0; j < CHUNK_SIZE; ++j) {
+                    chunk[j].~T();
+                }
+                ::operator delete(blocks[i]);
+            }
+        }
+
+        MtStableArray(const MtStableArray &) = delete;
+        MtStableArray &operator=(const MtStableArray &) = delete;
+
+        /** \brief Увеличить размер массива
+         *
+         * Метод может вызывать только один поток одновременно
+         * \param new_size Новый размер
+         */
+        void grow(const size_t new_size) {
+            const size_t old_size = array_size.load(std::memory_order_relaxed);
+            if(new_size <= old_size) return;
+            if(new_size > CHUNK_SIZE * MAX_CHUNKS)
+                throw std::length_error("mt-bridge: too many symbols");
+            for(size_t c = old_size / CHUNK_SIZE; c <= (new_size - 1) / CHUNK_SIZE; ++c) {
+                if(chunks[c].load(std::memory_order_relaxed) != nullptr) continue;
+                /* new T[] в C++11 не выравнивает память больше чем на 16 байт */
+                blocks[c] = ::operator new(CHUNK_SIZE * sizeof(T) + CACHE_LINE_SIZE);
+                const uintptr_t address = reinterpret_cast<uintptr_t>(blocks[c]);
+                T *chunk = reinterpret_cast<T*>((address + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE * CACHE_LINE_SIZE);
+                for(size_t j = 0; j < CHUNK_SIZE; ++j) {
+                    new(&chunk[j]) T();
+                }
+                chunks[c].store(chunk, std::memory_order_release);
+            }
+            array_size.store(new_size, std::memory_order_release);
+        }
+
+        inline size_t size() const {
+            return array_size.load(std::memory_order_acquire);
+        }
+
+        inline T &operator[](const size_t index) {
+            return chunks[index / CHUNK_SIZE].load(std::memory_order_acquire)[index % CHUNK_SIZE];
+        }
+
+        inline const T &operator[](const size_t index) const {
+            return chunks[index / CHUNK_SIZE].load(std::memory_order_acquire)[index % CHUNK_SIZE];
+        }
+    };
+};
+
+#endif // METATRADER_BRIDGE_SEQLOCK_HPP_INCLUDED
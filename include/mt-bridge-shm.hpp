@@ -0,0 +1,543 @@
+#ifndef METATRADER_BRIDGE_SHM_HPP_INCLUDED
+#define METATRADER_BRIDGE_SHM_HPP_INCLUDED
+
+#include "mt-bridge-seqlock.hpp"
+#include <string>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include <new>
+#include <cstring>
+#include <cstdint>
+
+#if defined(_WIN32)
+/* winsock2.h должен быть подключен раньше windows.h, иначе boost.asio не соберется */
+#include <winsock2.h>
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace mt_bridge {
+
+    /* Шина снимков в разделяемой памяти
+     *
+     * Сегмент разделяемой памяти состоит из заголовка MtShmHeader,
+     * таблицы символов (max_symbols записей MtShmSymbol) и кольца
+     * сообщений (capacity записей, capacity - степень двойки).
+     * Каждая запись кольца и каждая запись таблицы символов - это
+     * MtSeqlock, то есть у каждой записи свой счетчик последовательности.
+     * Писатель один - мост. Сообщение с номером n пишется в запись
+     * n % capacity, после чего write_index становится n + 1.
+     * Читатель сравнивает номер прочитанного сообщения с ожидаемым:
+     * если номер больше, читатель отстал на целое кольцо и сообщения потеряны
+     */
+
+    const uint32_t MT_BRIDGE_SHM_MAGIC = 0x5342544D;    /**< Сигнатура сегмента, "MTBS" */
+    const uint32_t MT_BRIDGE_SHM_VERSION = 2;
+    const size_t MT_BRIDGE_SHM_SYMBOL_NAME_SIZE = 64;
+
+    /// События шины
+    enum class MtShmEvent : uint32_t {
+        SYMBOL_ADDED = 0,   /**< Добавлен символ, имя уже есть в таблице символов */
+        UPDATE = 1,         /**< Новый тик и новое состояние бара M1 символа */
+    };
+
+    /** \brief Сообщение шины
+     */
+    class MtShmMessage {
+    public:
+        uint64_t index = 0;             /**< Номер сообщения */
+        MtShmEvent event = MtShmEvent::UPDATE;
+        uint32_t symbol_index = 0;      /**< Индекс символа в мосте */
+        double bid = 0;
+        double ask = 0;
+        double open = 0;
+        double high = 0;
+        double low = 0;
+        double close = 0;
+        double volume = 0;
+        uint64_t server_timestamp = 0;  /**< Метка времени сервера кадра */
+        uint64_t timestamp = 0;         /**< Метка времени бара M1 */
+    };
+
+    /** \brief Заголовок сегмента
+     */
+    class MtShmHeader {
+    public:
+        std::atomic<uint32_t> magic;    /**< Пишется последним, когда сегмент готов */
+        uint32_t version;
+        uint32_t capacity;
+        uint32_t max_symbols;
+        uint64_t generation;            /**< Время создания сегмента, наносекунды */
+        std::atomic<uint32_t> num_symbols;
+        std::atomic<uint32_t> is_closed;    /**< Мост закрыл сегмент */
+        /* счетчик писателя в отдельной строке кэша */
+        alignas(64) std::atomic<uint64_t> write_index;
+    };
+
+    /** \brief Запись таблицы символов
+     */
+    class MtShmSymbol {
+    public:
+        char name[MT_BRIDGE_SHM_SYMBOL_NAME_SIZE];
+        MtSeqlock<MtShmMessage> last;   /**< Последнее сообщение UPDATE символа */
+    };
+
+    /** \brief Объект разделяемой памяти
+     */
+    class MtShmObject {
+    private:
+#if defined(_WIN32)
+        HANDLE mapping = NULL;
+#endif
+        uint8_t *data = nullptr;
+        size_t size = 0;
+        std::string name;
+        bool is_owner = false;
+
+    public:
+
+        MtShmObject() {};
+
+        MtShmObject(const MtShmObject &) = delete;
+        MtShmObject &operator=(const MtShmObject &) = delete;
+
+        ~MtShmObject() {
+            close();
+        }
+
+        /** \brief Создать объект заново
+         *
+         * В POSIX старый объект с тем же именем удаляется, а читатели
+         * старого объекта продолжают работать со своей копией.
+         * В Windows объект существует, пока его держит хотя бы один процесс,
+         * поэтому, если читатели еще не закрыли старый объект, создать
+         * новый нельзя: метод вернет false, чтобы не стереть данные читателей
+         * \param shm_name Имя объекта, например "/mt-bridge"
+         * \param new_size Размер объекта
+         * \return Вернет true, если объект создан
+         */
+        bool create(const std::string &shm_name, const size_t new_size) {
+            close();
+#if defined(_WIN32)
+            mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE,
+                (DWORD)((uint64_t)new_size >> 32), (DWORD)(new_size & 0xFFFFFFFF), get_windows_name(shm_name).c_str());
+            if(mapping == NULL) return false;
+            if(GetLastError() == ERROR_ALREADY_EXISTS) {
+                close();
+                return false;
+            }
+            data = (uint8_t*)MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, new_size);
+            if(data == nullptr) {
+                close();
+                return false;
+            }
+            std::memset(data, 0, new_size);
+#else
+            shm_unlink(shm_name.c_str());
+            const int fd = shm_open(shm_name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+            if(fd < 0) return false;
+            if(ftruncate(fd, (off_t)new_size) != 0) {
+                ::close(fd);
+                shm_unlink(shm_name.c_str());
+                return false;
+            }
+            void *ptr = mmap(NULL, new_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            ::close(fd);
+            if(ptr == MAP_FAILED) {
+                shm_unlink(shm_name.c_str());
+                return false;
+            }
+            data = (uint8_t*)ptr;
+#endif
+            size = new_size;
+            name = shm_name;
+            is_owner = true;
+            return true;
+        }
+
+        /** \brief Открыть существующий объект только для чтения
+         * \param shm_name Имя объекта
+         * \return Вернет true, если объект открыт
+         */
+        bool open(const std::string &shm_name) {
+            close();
+#if defined(_WIN32)
+            mapping = OpenFileMappingA(FILE_MAP_READ, FALSE, get_windows_name(shm_name).c_str());
+            if(mapping == NULL) return false;
+            data = (uint8_t*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+            if(data == nullptr) {
+                close();
+                return false;
+            }
+            MEMORY_BASIC_INFORMATION info;
+            if(VirtualQuery(data, &info, sizeof(info)) == 0) {
+                close();
+                return false;
+            }
+            size = info.RegionSize;
+#else
+            const int fd = shm_open(shm_name.c_str(), O_RDONLY, 0);
+            if(fd < 0) return false;
+            struct stat st;
+            if(fstat(fd, &st) != 0 || st.st_size == 0) {
+                ::close(fd);
+                return false;
+            }
+            void *ptr = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+            ::close(fd);
+            if(ptr == MAP_FAILED) return false;
+            data = (uint8_t*)ptr;
+            size = (size_t)st.st_size;
+#endif
+            name = shm_name;
+            is_owner = false;
+            return true;
+        }
+
+        void close() {
+#if defined(_WIN32)
+            if(data != nullptr) UnmapViewOfFile(data);
+            if(mapping != NULL) CloseHandle(mapping);
+            mapping = NULL;
+#else
+            if(data != nullptr) {
+                munmap(data, size);
+                if(is_owner) shm_unlink(name.c_str());
+            }
+#endif
+            data = nullptr;
+            size = 0;
+            is_owner = false;
+        }
+
+#if defined(_WIN32)
+        static std::string get_windows_name(const std::string &shm_name) {
+            return "Local\\" + (shm_name.size() > 0 && shm_name[0] == '/' ? shm_name.substr(1) : shm_name);
+        }
+#endif
+
+        inline bool is_open() const {
+            return data != nullptr;
+        }
+
+        inline uint8_t *get_data() {
+            return data;
+        }
+
+        inline const uint8_t *get_data() const {
+            return data;
+        }
+
+        inline size_t get_size() const {
+            return size;
+        }
+    };
+
+    /** \brief Размещение частей сегмента
+     */
+    class MtShmLayout {
+    public:
+        size_t symbols_offset = 0;
+        size_t slots_offset = 0;
+        size_t size = 0;
+
+        MtShmLayout(const uint32_t capacity, const uint32_t max_symbols) {
+            const size_t ALIGNMENT = 64;
+            symbols_offset = (sizeof(MtShmHeader) + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+            slots_offset = symbols_offset +
+                ((size_t)max_symbols * sizeof(MtShmSymbol) + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+            size = slots_offset + (size_t)capacity * sizeof(MtSeqlock<MtShmMessage>);
+        }
+    };
+
+    /** \brief Писатель шины (мост)
+     *
+     * Методы вызывает один поток одновременно
+     */
+    class MtShmPublisher {
+    private:
+        MtShmObject shm;
+        MtShmHeader *header = nullptr;
+        MtShmSymbol *symbols = nullptr;
+        MtSeqlock<MtShmMessage> *slots = nullptr;
+        uint64_t mask = 0;
+
+    public:
+
+        MtShmPublisher() {};
+
+        MtShmPublisher(const MtShmPublisher &) = delete;
+        MtShmPublisher &operator=(const MtShmPublisher &) = delete;
+
+        ~MtShmPublisher() {
+            close();
+        }
+
+        /** \brief Создать сегмент
+         * \param name Имя объекта разделяемой памяти, например "/mt-bridge"
+         * \param capacity Емкость кольца сообщений, округляется вверх до степени двойки
+         * \param max_symbols Максимальное количество символов
+         * \return Вернет true, если сегмент создан
+         */
+        bool open(const std::string &name, const uint32_t capacity, const uint32_t max_symbols) {
+            close();
+            uint32_t ring_capacity = 1;
+            while(ring_capacity < capacity) ring_capacity <<= 1;
+            const MtShmLayout layout(ring_capacity, max_symbols);
+            if(!shm.create(name, layout.size)) return false;
+
+            uint8_t *data = shm.get_data();
+            header = new(data) MtShmHeader();
+            symbols = reinterpret_cast<MtShmSymbol*>(data + layout.symbols_offset);
+            for(uint32_t s = 0; s < max_symbols; ++s) {
+                new(&symbols[s]) MtShmSymbol();
+                std::memset(symbols[s].name, 0, MT_BRIDGE_SHM_SYMBOL_NAME_SIZE);
+            }
+            slots = reinterpret_cast<MtSeqlock<MtShmMessage>*>(data + layout.slots_offset);
+            for(uint32_t i = 0; i < ring_capacity; ++i) {
+                new(&slots[i]) MtSeqlock<MtShmMessage>();
+            }
+            mask = ring_capacity - 1;
+
+            header->version = MT_BRIDGE_SHM_VERSION;
+            header->capacity = ring_capacity;
+            header->max_symbols = max_symbols;
+            header->generation = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count();
+            header->num_symbols.store(0, std::memory_order_relaxed);
+            header->is_closed.store(0, std::memory_order_relaxed);
+            header->write_index.store(0, std::memory_order_relaxed);
+            header->magic.store(MT_BRIDGE_SHM_MAGIC, std::memory_order_release);
+            return true;
+        }
+
+        /** \brief Закрыть сегмент
+         *
+         * Читатели увидят флаг is_closed, объект удаляется из системы
+         * после того, как его закроют все читатели
+         */
+        void close() {
+            if(header == nullptr) return;
+            header->is_closed.store(1, std::memory_order_release);
+            shm.close();
+            header = nullptr;
+            symbols = nullptr;
+            slots = nullptr;
+        }
+
+        inline bool is_open() const {
+            return header != nullptr;
+        }
+
+        /** \brief Добавить символ
+         * \param symbol_index Индекс символа в мосте
+         * \param symbol_name Имя символа
+         * \return Вернет false, если символ не помещается в таблицу символов
+         */
+        bool add_symbol(const uint32_t symbol_index, const std::string &symbol_name) {
+            if(header == nullptr || symbol_index >= header->max_symbols) return false;
+            std::memset(symbols[symbol_index].name, 0, MT_BRIDGE_SHM_SYMBOL_NAME_SIZE);
+            std::memcpy(symbols[symbol_index].name, symbol_name.c_str(),
+                std::min(symbol_name.size(), MT_BRIDGE_SHM_SYMBOL_NAME_SIZE - 1));
+            if(symbol_index >= header->num_symbols.load(std::memory_order_relaxed)) {
+                header->num_symbols.store(symbol_index + 1, std::memory_order_release);
+            }
+            MtShmMessage message;
+            message.event = MtShmEvent::SYMBOL_ADDED;
+            message.symbol_index = symbol_index;
+            publish(message);
+            return true;
+        }
+
+        /** \brief Опубликовать сообщение
+         * \param message Сообщение, номер сообщения заполняется автоматически
+         */
+        void publish(MtShmMessage message) {
+            if(header == nullptr) return;
+            const uint64_t index = header->write_index.load(std::memory_order_relaxed);
+            message.index = index;
+            slots[index & mask].store(message);
+            if(message.event == MtShmEvent::UPDATE && message.symbol_index < header->max_symbols) {
+                symbols[message.symbol_index].last.store(message);
+            }
+            header->write_index.store(index + 1, std::memory_order_release);
+        }
+    };
+
+    /** \brief Читатель шины
+     *
+     * Подключается к сегменту только для чтения, не использует Boost.Asio
+     * и сокеты. Один объект читателя может использовать один поток
+     */
+    class MtShmSubscriber {
+    private:
+        MtShmObject shm;
+        const MtShmHeader *header = nullptr;
+        const MtShmSymbol *symbols = nullptr;
+        const MtSeqlock<MtShmMessage> *slots = nullptr;
+        uint64_t mask = 0;
+        uint64_t capacity = 0;
+        uint64_t read_index = 0;
+        uint64_t lost = 0;
+        uint64_t generation = 0;
+
+    public:
+
+        MtShmSubscriber() {};
+
+        MtShmSubscriber(const MtShmSubscriber &) = delete;
+        MtShmSubscriber &operator=(const MtShmSubscriber &) = delete;
+
+        /** \brief Подключиться к сегменту
+         *
+         * Чтение начинается с сообщений, опубликованных после подключения,
+         * текущее состояние символов можно получить методом get_last
+         * \param name Имя объекта разделяемой памяти
+         * \return Вернет true, если сегмент открыт и готов
+         */
+        bool open(const std::string &name) {
+            close();
+            if(!shm.open(name)) return false;
+            if(shm.get_size() < sizeof(MtShmHeader)) {
+                close();
+                return false;
+            }
+            const uint8_t *data = shm.get_data();
+            header = reinterpret_cast<const MtShmHeader*>(data);
+            if(header->magic.load(std::memory_order_acquire) != MT_BRIDGE_SHM_MAGIC ||
+                header->version != MT_BRIDGE_SHM_VERSION) {
+                close();
+                return false;
+            }
+            const MtShmLayout layout(header->capacity, header->max_symbols);
+            if(shm.get_size() < layout.size) {
+                close();
+                return false;
+            }
+            symbols = reinterpret_cast<const MtShmSymbol*>(data + layout.symbols_offset);
+            slots = reinterpret_cast<const MtSeqlock<MtShmMessage>*>(data + layout.slots_offset);
+            capacity = header->capacity;
+            mask = capacity - 1;
+            generation = header->generation;
+            read_index = header->write_index.load(std::memory_order_acquire);
+            lost = 0;
+            return true;
+        }
+
+        void close() {
+            shm.close();
+            header = nullptr;
+            symbols = nullptr;
+            slots = nullptr;
+        }
+
+        inline bool is_open() const {
+            return header != nullptr;
+        }
+
+        /** \brief Проверить, закрыл ли мост сегмент
+         *
+         * После перезапуска моста нужно заново вызвать open
+         * \return Вернет true, если мост закрыл сегмент
+         */
+        inline bool is_closed() const {
+            return header == nullptr || header->is_closed.load(std::memory_order_acquire) != 0;
+        }
+
+        /** \brief Получить время создания сегмента
+         * \return Время создания сегмента, наносекунды
+         */
+        inline uint64_t get_generation() const {
+            return generation;
+        }
+
+        /** \brief Получить количество пропущенных сообщений
+         *
+         * Сообщения пропускаются, если читатель отстал от моста больше чем на емкость кольца
+         * \return Количество пропущенных сообщений
+         */
+        inline uint64_t get_lost() const {
+            return lost;
+        }
+
+        inline uint32_t get_num_symbols() const {
+            if(header == nullptr) return 0;
+            return header->num_symbols.load(std::memory_order_acquire);
+        }
+
+        /** \brief Получить имя символа
+         * \param symbol_index Индекс символа
+         * \return Имя символа
+         */
+        std::string get_symbol_name(const uint32_t symbol_index) const {
+            if(symbol_index >= get_num_symbols()) return std::string();
+            const char *name = symbols[symbol_index].name;
+            return std::string(name, strnlen(name, MT_BRIDGE_SHM_SYMBOL_NAME_SIZE));
+        }
+
+        /** \brief Получить последнее сообщение UPDATE символа
+         * \param symbol_index Индекс символа
+         * \return Сообщение, у символа без данных все цены равны 0
+         */
+        MtShmMessage get_last(const uint32_t symbol_index) const {
+            if(symbol_index >= get_num_symbols()) return MtShmMessage();
+            return symbols[symbol_index].last.load();
+        }
+
+        /** \brief Прочитать следующее сообщение без ожидания
+         * \param message Сообщение
+         * \return Вернет true, если сообщение прочитано
+         */
+        bool poll(MtShmMessage &message) {
+            if(header == nullptr) return false;
+            while(true) {
+                const uint64_t write_index = header->write_index.load(std::memory_order_acquire);
+                if(read_index >= write_index) return false;
+                if(write_index - read_index > capacity) {
+                    lost += write_index - capacity - read_index;
+                    read_index = write_index - capacity;
+                }
+                message = slots[read_index & mask].load();
+                if(message.index == read_index) {
+                    ++read_index;
+                    return true;
+                }
+                /* запись перезаписана, пока мы ее читали */
+                ++lost;
+                ++read_index;
+            }
+        }
+
+        /** \brief Дождаться следующего сообщения
+         *
+         * Сегмент открыт только для чтения, поэтому мост не может
+         * разбудить читателя: читатель сначала крутится в цикле
+         * spin_count проверок, затем засыпает на короткое время
+         * \param message Сообщение
+         * \param timeout_ms Время ожидания в миллисекундах
+         * \param spin_count Количество проверок без сна
+         * \return Вернет true, если сообщение прочитано
+         */
+        bool wait(MtShmMessage &message, const uint32_t timeout_ms, const uint32_t spin_count = 10000) {
+            for(uint32_t i = 0; i < spin_count; ++i) {
+                if(poll(message)) return true;
+            }
+            const std::chrono::steady_clock::time_point stop_time =
+                std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+            while(true) {
+                if(poll(message)) return true;
+                if(is_closed() || std::chrono::steady_clock::now() >= stop_time) return false;
+                std::this_thread::sleep_for(std::chrono::microseconds(50));
+            }
+        }
+    };
+};
+
+#endif // METATRADER_BRIDGE_SHM_HPP_INCLUDED
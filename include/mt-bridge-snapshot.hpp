@@ -0,0 +1,111 @@
+#ifndef METATRADER_BRIDGE_SNAPSHOT_HPP_INCLUDED
+#define METATRADER_BRIDGE_SNAPSHOT_HPP_INCLUDED
+
+#include <vector>
+#include <string>
+#include <cstdint>
+
+namespace mt_bridge {
+
+    /** \brief Снимок баров всех символов
+     *
+     * Бары лежат в заранее выделенном массиве и адресуются индексом символа,
+     * который совпадает с индексом символа в мосте. Таблица имен символов
+     * меняется только при подключении терминала с новыми символами,
+     * поэтому в установившемся режиме заполнение снимка не выделяет память
+     */
+    template<class CANDLE_TYPE>
+    class MtSnapshot {
+    private:
+        std::vector<CANDLE_TYPE> candles;
+        std::vector<std::string> symbol_names;
+        uint64_t timestamp = 0;
+
+    public:
+
+        /** \brief Получить количество символов
+         * \return Количество символов
+         */
+        inline uint32_t size() const {
+            return candles.size();
+        }
+
+        /** \brief Получить бар символа
+         * \param symbol_index Индекс символа
+         * \return Бар. Если данных нет, у бара close и timestamp равны 0
+         */
+        inline const CANDLE_TYPE &operator[](const uint32_t symbol_index) const {
+            return candles[symbol_index];
+        }
+
+        /** \brief Получить бар символа
+         * \param symbol_index Индекс символа
+         * \return Бар. Если данных нет, у бара close и timestamp равны 0
+         */
+        inline const CANDLE_TYPE &get_candle(const uint32_t symbol_index) const {
+            return candles[symbol_index];
+        }
+
+        /** \brief Получить имя символа
+         * \param symbol_index Индекс символа
+         * \return Имя символа
+         */
+        inline const std::string &get_symbol_name(const uint32_t symbol_index) const {
+            return symbol_names[symbol_index];
+        }
+
+        /** \brief Получить таблицу имен символов
+         * \return Имена символов по индексу символа
+         */
+        inline const std::vector<std::string> &get_symbol_names() const {
+            return symbol_names;
+        }
+
+        /** \brief Найти индекс символа по имени
+         *
+         * Метод выполняет линейный поиск, индекс лучше найти один раз
+         * \param symbol_name Имя символа
+         * \return Индекс символа или -1, если символа нет
+         */
+        int32_t find_symbol(const std::string &symbol_name) const {
+            for(size_t i = 0; i < symbol_names.size(); ++i) {
+                if(symbol_names[i] == symbol_name) return i;
+            }
+            return -1;
+        }
+
+        /** \brief Получить метку времени снимка
+         * \return Метка времени
+         */
+        inline uint64_t get_timestamp() const {
+            return timestamp;
+        }
+
+        /** \brief Получить указатель на массив баров
+         * \return Указатель на бар первого символа
+         */
+        inline const CANDLE_TYPE *data() const {
+            return candles.data();
+        }
+
+        /* методы для заполнения снимка мостом */
+
+        /** \brief Обновить таблицу имен символов
+         * \param names Имена символов
+         */
+        void set_symbol_names(const std::vector<std::string> &names) {
+            symbol_names = names;
+            candles.resize(symbol_names.size());
+        }
+
+        inline void set_timestamp(const uint64_t t) {
+            timestamp = t;
+        }
+
+        inline CANDLE_TYPE &at(const uint32_t symbol_index) {
+            return candles[symbol_index];
+        }
+    };
+};
+
+#endif // METATRADER_BRIDGE_SNAPSHOT_HPP_INCLUDED
@@ -0,0 +1,114 @@
+#ifndef METATRADER_BRIDGE_SYMBOLS_HPP_INCLUDED
+#define METATRADER_BRIDGE_SYMBOLS_HPP_INCLUDED
+
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdint>
+
+namespace mt_bridge {
+
+    /** \brief Дескриптор символа
+     *
+     * Индекс символа в мосте не меняется, поэтому имя символа достаточно
+     * найти один раз, а дальше обращаться к данным по дескриптору без поиска
+     */
+    class MtSymbolHandle {
+    public:
+        uint32_t index = UINT32_MAX;    /**< Индекс символа или UINT32_MAX, если символа нет */
+
+        MtSymbolHandle() {};
+
+        explicit MtSymbolHandle(const uint32_t i) : index(i) {};
+
+        inline bool is_valid() const {
+            return index != UINT32_MAX;
+        }
+    };
+
+    /** \brief Неизменяемая таблица имен символов
+     *
+     * Открытая адресация с линейным пробированием, таблица заполнена
+     * не больше чем наполовину. В ячейке хранится хеш имени, поэтому
+     * строки сравниваются только при совпадении хеша. После создания
+     * таблица не меняется, и читать ее можно из любых потоков без блокировок
+     */
+    class MtSymbolTable {
+    private:
+        class Slot {
+        public:
+            uint64_t hash = 0;
+            uint32_t index = UINT32_MAX;
+        };
+
+        std::vector<std::string> names;
+        std::vector<Slot> slots;
+        size_t mask = 0;
+
+    public:
+
+        /** \brief Хеш FNV-1a имени символа
+         * \param data Имя символа
+         * \param size Длина имени
+         * \return Хеш
+         */
+        static inline uint64_t get_hash(const char *data, const size_t size) {
+            uint64_t hash = 14695981039346656037ULL;
+            for(size_t i = 0; i < size; ++i) {
+                hash ^= (uint8_t)data[i];
+                hash *= 1099511628211ULL;
+            }
+            return hash;
+        }
+
+        MtSymbolTable() : slots(1) {};
+
+        /** \brief Построить таблицу
+         * \param symbol_names Имена символов по индексу символа
+         */
+        MtSymbolTable(const std::vector<std::string> &symbol_names) : names(symbol_names) {
+            size_t capacity = 1;
+            while(capacity < 2 * names.size()) capacity <<= 1;
+            slots.resize(capacity);
+            mask = capacity - 1;
+            for(uint32_t s = 0; s < names.size(); ++s) {
+                const uint64_t hash = get_hash(names[s].data(), names[s].size());
+                size_t pos = (size_t)hash & mask;
+                while(slots[pos].index != UINT32_MAX) pos = (pos + 1) & mask;
+                slots[pos].hash = hash;
+                slots[pos].index = s;
+            }
+        }
+
+        inline size_t size() const {
+            return names.size();
+        }
+
+        /** \brief Найти символ
+         * \param data Имя символа
+         * \param size Длина имени
+         * \return Дескриптор символа, is_valid() вернет false, если символа нет
+         */
+        MtSymbolHandle find(const char *data, const size_t size) const {
+            const uint64_t hash = get_hash(data, size);
+            size_t pos = (size_t)hash & mask;
+            while(true) {
+                const Slot &slot = slots[pos];
+                if(slot.index == UINT32_MAX) return MtSymbolHandle();
+                if(slot.hash == hash) {
+                    const std::string &name = names[slot.index];
+                    if(name.size() == size && std::memcmp(name.data(), data, size) == 0) {
+                        return MtSymbolHandle(slot.index);
+                    }
+                }
+                pos = (pos + 1) & mask;
+            }
+        }
+
+        inline MtSymbolHandle find(const std::string &name) const {
+            return find(name.data(), name.size());
+        }
+    };
+};
+
+#endif // METATRADER_BRIDGE_SYMBOLS_HPP_INCLUDED
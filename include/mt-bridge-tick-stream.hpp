@@ -0,0 +1,211 @@
+#ifndef METATRADER_BRIDGE_TICK_STREAM_HPP_INCLUDED
+#define METATRADER_BRIDGE_TICK_STREAM_HPP_INCLUDED
+
+#include <atomic>
+#include <array>
+#include <memory>
+#include <thread>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+
+namespace mt_bridge {
+
+    const size_t MT_BRIDGE_TICK_BATCH_SIZE = 256;   /**< Сколько тиков поток моста читает из очереди за раз */
+
+    /** \brief Тик символа из потока тиков
+     */
+    class MtRawTick {
+    public:
+        uint32_t symbol_index;      /**< Индекс символа в мосте */
+        double bid;
+        double ask;
+        uint64_t server_timestamp;  /**< Метка времени сервера кадра с учетом часового пояса */
+        double receive_time;        /**< Время компьютера в момент декодирования кадра (секунды с дробной частью) */
+
+        MtRawTick() :
+            symbol_index(0), bid(0), ask(0), server_timestamp(0), receive_time(0) {
+        }
+
+        MtRawTick(
+                const uint32_t _symbol_index,
+                const double _bid,
+                const double _ask,
+                const uint64_t _server_timestamp,
+                const double _receive_time) :
+            symbol_index(_symbol_index), bid(_bid), ask(_ask),
+            server_timestamp(_server_timestamp), receive_time(_receive_time) {
+        }
+    };
+
+    /// Что делать, если очередь тиков переполнена
+    enum class MtTickOverflow {
+        DROP_OLDEST,    /**< Перезаписать самый старый тик */
+        BLOCK,          /**< Ждать, пока читатель освободит место */
+    };
+
+    /** \brief Очередь без блокировок для одного писателя и одного читателя
+     *
+     * Емкость очереди округляется вверх до степени двойки. При переполнении
+     * писатель либо удаляет самый старый элемент, либо ждет читателя.
+     * Элементы хранятся в атомарных словах: если писатель перезаписал элемент,
+     * который в этот момент копирует читатель, читатель отбрасывает копию
+     */
+    template<class T>
+    class MtSpscQueue {
+    private:
+        static const size_t NUM_WORDS = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+        static const size_t CACHE_LINE_SIZE = 64;
+
+        class Slot {
+        public:
+            std::array<std::atomic<uint64_t>, NUM_WORDS> words;
+        };
+
+        std::unique_ptr<Slot[]> slots;
+        uint64_t capacity = 0;
+        uint64_t mask = 0;
+
+        /* позиции читателя и писателя лежат в разных строках кэша */
+        uint8_t padding_0[CACHE_LINE_SIZE];
+        std::atomic<uint64_t> head;     /**< Позиция читателя */
+        uint8_t padding_1[CACHE_LINE_SIZE - sizeof(std::atomic<uint64_t>)];
+        std::atomic<uint64_t> tail;     /**< Позиция писателя */
+        std::atomic<uint64_t> dropped;  /**< Количество перезаписанных элементов */
+        std::atomic<uint64_t> blocked;  /**< Сколько раз писатель ждал читателя */
+        std::atomic<bool> is_closed;
+        uint8_t padding_2[CACHE_LINE_SIZE];
+
+        inline void write_slot(const uint64_t pos, const T &value) {
+            uint64_t data[NUM_WORDS] = {};
+            std::memcpy(data, &value, sizeof(T));
+            Slot &slot = slots[pos & mask];
+            for(size_t i = 0; i < NUM_WORDS; ++i) {
+                slot.words[i].store(data[i], std::memory_order_relaxed);
+            }
+        }
+
+        inline void read_slot(const uint64_t pos, T &value) const {
+            uint64_t data[NUM_WORDS];
+            const Slot &slot = slots[pos & mask];
+            for(size_t i = 0; i < NUM_WORDS; ++i) {
+                data[i] = slot.words[i].load(std::memory_order_relaxed);
+            }
+            std::memcpy(&value, data, sizeof(T));
+        }
+
+    public:
+
+        /** \brief Конструктор очереди
+         * \param min_capacity Минимальная емкость очереди
+         */
+        MtSpscQueue(const size_t min_capacity) {
+            capacity = 1;
+            while(capacity < min_capacity) capacity <<= 1;
+            mask = capacity - 1;
+            slots.reset(new Slot[capacity]);
+            for(uint64_t s = 0; s < capacity; ++s) {
+                for(size_t i = 0; i < NUM_WORDS; ++i) {
+                    slots[s].words[i].store(0, std::memory_order_relaxed);
+                }
+            }
+            head.store(0, std::memory_order_relaxed);
+            tail.store(0, std::memory_order_relaxed);
+            dropped.store(0, std::memory_order_relaxed);
+            blocked.store(0, std::memory_order_relaxed);
+            is_closed.store(false, std::memory_order_relaxed);
+        }
+
+        MtSpscQueue(const MtSpscQueue &) = delete;
+        MtSpscQueue &operator=(const MtSpscQueue &) = delete;
+
+        /** \brief Добавить элемент
+         *
+         * Метод может вызывать только один поток одновременно
+         * \param value Элемент
+         * \param overflow Что делать, если очередь переполнена
+         * \return Вернет false, если очередь закрыта, а элемент не добавлен
+         */
+        bool push(const T &value, const MtTickOverflow overflow) {
+            const uint64_t t = tail.load(std::memory_order_relaxed);
+            uint64_t h = head.load(std::memory_order_acquire);
+            if(t - h >= capacity) {
+                if(overflow == MtTickOverflow::DROP_OLDEST) {
+                    /* сдвигаем позицию читателя, если читатель не успел сделать это сам */
+                    while(t - h >= capacity) {
+                        if(head.compare_exchange_weak(h, h + 1, std::memory_order_acq_rel)) {
+                            ++dropped;
+                            break;
+                        }
+                    }
+                } else {
+                    ++blocked;
+                    while(t - head.load(std::memory_order_acquire) >= capacity) {
+                        if(is_closed.load(std::memory_order_relaxed)) return false;
+                        std::this_thread::yield();
+                    }
+                }
+            }
+            write_slot(t, value);
+            tail.store(t + 1, std::memory_order_release);
+            return true;
+        }
+
+        /** \brief Забрать элементы
+         *
+         * Метод может вызывать только один поток одновременно
+         * \param values Массив для элементов
+         * \param max_count Размер массива
+         * \return Количество прочитанных элементов
+         */
+        size_t pop(T *values, const size_t max_count) {
+            uint64_t h = head.load(std::memory_order_acquire);
+            while(true) {
+                const uint64_t t = tail.load(std::memory_order_acquire);
+                if(h >= t) return 0;
+                const size_t count = (size_t)std::min((uint64_t)max_count, t - h);
+                for(size_t i = 0; i < count; ++i) {
+                    read_slot(h + i, values[i]);
+                }
+                /* если писатель за это время перезаписал элементы, повторяем чтение */
+                if(head.compare_exchange_strong(h, h + count, std::memory_order_acq_rel)) return count;
+            }
+        }
+
+        /** \brief Проверить, пуста ли очередь
+         * \return Вернет true, если элементов нет
+         */
+        inline bool empty() const {
+            return head.load(std::memory_order_acquire) >= tail.load(std::memory_order_acquire);
+        }
+
+        /** \brief Получить количество элементов в очереди
+         * \return Количество элементов
+         */
+        inline size_t size() const {
+            const uint64_t h = head.load(std::memory_order_acquire);
+            const uint64_t t = tail.load(std::memory_order_acquire);
+            return t > h ? (size_t)(t - h) : 0;
+        }
+
+        /** \brief Закрыть очередь, писатель перестанет ждать читателя
+         */
+        inline void close() {
+            is_closed.store(true);
+        }
+
+        inline uint64_t get_capacity() const {
+            return capacity;
+        }
+
+        inline uint64_t get_dropped() const {
+            return dropped.load(std::memory_order_relaxed);
+        }
+
+        inline uint64_t get_blocked() const {
+            return blocked.load(std::memory_order_relaxed);
+        }
+    };
+};
+
+#endif // METATRADER_BRIDGE_TICK_STREAM_HPP_INCLUDED
@@ -0,0 +1,98 @@
+#ifndef METATRADER_BRIDGE_TIMEFRAMES_HPP_INCLUDED
+#define METATRADER_BRIDGE_TIMEFRAMES_HPP_INCLUDED
+
+#include "mt-bridge-candles.hpp"
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+
+namespace mt_bridge {
+
+    /** \brief Бары старшего таймфрейма, собранные из баров M1
+     *
+     * Бар таймфрейма - это бары M1, закрытые внутри периода таймфрейма,
+     * и текущий бар M1. Закрытые бары копятся в одном баре, поэтому
+     * любое обновление бара M1, в том числе повторное обновление
+     * несформированного бара, пересчитывает бар таймфрейма за O(1).
+     * Метка времени бара - начало периода таймфрейма
+     */
+    template<class CANDLE_TYPE>
+    class MtTimeframeAggregator {
+    private:
+        static const uint64_t SECONDS_IN_MINUTE = 60;
+
+        uint32_t timeframe;             /**< Таймфрейм в минутах */
+        MtCandleStore<CANDLE_TYPE> candles;
+        CANDLE_TYPE closed_candle;      /**< Бары M1, закрытые в текущем баре таймфрейма */
+        CANDLE_TYPE last_candle;        /**< Последний бар M1 */
+        bool is_closed_candle = false;
+        bool is_last_candle = false;
+
+        static inline CANDLE_TYPE merge(const CANDLE_TYPE &first, const CANDLE_TYPE &second) {
+            return CANDLE_TYPE(
+                first.open,
+                std::max(first.high, second.high),
+                std::min(first.low, second.low),
+                second.close,
+                first.volume + second.volume,
+                first.timestamp);
+        }
+
+    public:
+
+        /** \brief Конструктор таймфрейма
+         * \param timeframe_minutes Таймфрейм в минутах, например 5, 60 или 1440
+         * \param retention_bars Максимальное количество баров, 0 - без ограничения
+         * \param retention_seconds Максимальная глубина истории в секундах, 0 - без ограничения
+         */
+        MtTimeframeAggregator(
+                const uint32_t timeframe_minutes,
+                const size_t retention_bars = 0,
+                const uint64_t retention_seconds = 0) :
+            timeframe(timeframe_minutes),
+            candles(retention_bars, retention_seconds, (uint64_t)timeframe_minutes * SECONDS_IN_MINUTE) {
+        }
+
+        inline uint32_t get_timeframe() const {
+            return timeframe;
+        }
+
+        inline const MtCandleStore<CANDLE_TYPE> &get_candles() const {
+            return candles;
+        }
+
+        inline void clear() {
+            candles.clear();
+            is_closed_candle = false;
+            is_last_candle = false;
+        }
+
+        /** \brief Обновить бар таймфрейма баром M1
+         *
+         * Бары M1 старше последнего игнорируются
+         * \param candle Бар M1
+         * \return Вернет true, если бар таймфрейма добавлен или обновлен
+         */
+        bool update(const CANDLE_TYPE &candle) {
+            if(is_last_candle && candle.timestamp < last_candle.timestamp) return false;
+            const uint64_t period = candles.get_period();
+            const uint64_t start_timestamp = (candle.timestamp / period) * period;
+            if(is_last_candle && candle.timestamp > last_candle.timestamp) {
+                /* последний бар M1 закрыт */
+                if((last_candle.timestamp / period) * period == start_timestamp) {
+                    closed_candle = is_closed_candle ? merge(closed_candle, last_candle) : last_candle;
+                    is_closed_candle = true;
+                } else {
+                    is_closed_candle = false;
+                }
+            }
+            last_candle = candle;
+            is_last_candle = true;
+            CANDLE_TYPE timeframe_candle = is_closed_candle ? merge(closed_candle, candle) : candle;
+            timeframe_candle.timestamp = start_timestamp;
+            return candles.update(timeframe_candle);
+        }
+    };
+};
+
+#endif // METATRADER_BRIDGE_TIMEFRAMES_HPP_INCLUDED
@@ -1,8 +1,33 @@
 #ifndef METATRADER_BRIDGE_HPP_INCLUDED
 #define METATRADER_BRIDGE_HPP_INCLUDED
 
+#include "mt-bridge-buffer.hpp"
+#include "mt-bridge-protocol.hpp"
+#include "mt-bridge-seqlock.hpp"
+#include "mt-bridge-symbols.hpp"
+#include "mt-bridge-candles.hpp"
+#include "mt-bridge-timeframes.hpp"
+#include "mt-bridge-indicators.hpp"
+#include "mt-bridge-snapshot.hpp"
+#include "mt-bridge-history.hpp"
+#include "mt-bridge-tick-stream.hpp"
+#include "mt-bridge-journal.hpp"
+#include "mt-bridge-clock.hpp"
+#include "mt-bridge-replay.hpp"
+#include "mt-bridge-metrics.hpp"
+#include "mt-bridge-offset.hpp"
+#include "mt-bridge-shm.hpp"
+#include "mt-bridge-rebroadcast.hpp"
 #include <iostream>
 #include <string>
+#include <vector>
+#include <map>
+#include <array>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <functional>
+#include <condition_variable>
 #include <boost/bind.hpp>
 #include <boost/shared_ptr.hpp>
 #include <boost/enable_shared_from_this.hpp>
@@ -70,199 +95,1425 @@ namespace mt_bridge {
      */
     template<class CANDLE_TYPE = MtCandle>
     class MetatraderBridge {
+    public:
+
+        /// Типы События
+        enum class EventType {
+            NEW_TICK,                   /**< Получен новый тик */
+            HISTORICAL_DATA_RECEIVED,   /**< Получены исторические данные */
+            NEW_RAW_TICK,               /**< Получен тик из потока тиков */
+        };
+
+        /// Типы цены
+        enum class PriceType {
+            PRICE_BID,          /**< Цена Bid */
+            PRICE_ASK,          /**< Цена Ask */
+            PRICE_BID_ASK_DIV2  /**< Цена (bid+ask)/2 */
+        };
+
+        typedef MtSymbolHandle SymbolHandle;    /**< Дескриптор символа */
+
+        /// Функция обработки событий
+        typedef std::function<void(
+            const std::map<std::string, CANDLE_TYPE> &candles,
+            const EventType event,
+            const uint64_t timestamp)> Callback;
+
+        /// Функция обработки событий, которая получает снимок баров всех символов по индексу символа
+        typedef std::function<void(
+            const MtSnapshot<CANDLE_TYPE> &snapshot,
+            const EventType event,
+            const uint64_t timestamp)> SnapshotCallback;
+
+        /// Функция обработки событий NEW_RAW_TICK, вызывается для каждого тика из потока тиков
+        typedef std::function<void(
+            const MtRawTick &tick,
+            const EventType event,
+            const uint64_t timestamp)> TickCallback;
+
+        /// Функция обработки событий старших таймфреймов, получает снимок закрытых баров таймфрейма всех символов
+        typedef std::function<void(
+            const MtSnapshot<CANDLE_TYPE> &snapshot,
+            const uint32_t timeframe,
+            const EventType event,
+            const uint64_t timestamp)> TimeframeCallback;
+
+        /// Функция обработки значений индикаторов, вызывается вместе с событием NEW_TICK с тем же снимком баров
+        typedef std::function<void(
+            const MtSnapshot<CANDLE_TYPE> &snapshot,
+            const MtIndicatorValues &values,
+            const EventType event,
+            const uint64_t timestamp)> IndicatorCallback;
+
+        /// Функция, которая получает исторические данные для первоначальной инициализации одним вызовом
+        typedef std::function<void(const MtHistoryMatrix &history)> HistoryCallback;
+
+        /// Функция, которая создает оценщик смещения времени сервера для терминала
+        typedef std::function<std::unique_ptr<MtOffsetEstimator>()> OffsetEstimatorFactory;
+
+        /// Функция, которая получает вытесненные из памяти бары (вызывается под блокировкой баров)
+        typedef std::function<void(
+            const uint32_t symbol_index,
+            const CANDLE_TYPE &candle)> SpillCallback;
+
+        /** \brief Настройки моста
+         */
+        class Config {
+        public:
+            uint32_t port = 5555;           /**< Номер порта */
+            uint32_t number_bars = 1440;    /**< Количество баров в истории для первоначальной инициализации callback */
+            uint32_t io_threads = 1;        /**< Количество потоков ввода-вывода */
+            uint32_t max_terminals = 1;     /**< Максимальное количество одновременно подключенных терминалов */
+            std::vector<std::string> terminal_names;    /**< Имена терминалов по номеру слота, по умолчанию T0, T1 и т.д. Слот получает терминал, который передал это имя */
+            Callback callback = nullptr;    /**< Функция обработки событий */
+            SnapshotCallback snapshot_callback = nullptr;   /**< Функция обработки событий без выделения памяти в установившемся режиме */
+            HistoryCallback history_callback = nullptr;     /**< Функция, которая получает исторические данные для первоначальной инициализации вместо событий HISTORICAL_DATA_RECEIVED */
+            std::vector<uint32_t> timeframes;               /**< Старшие таймфреймы всех символов в минутах, например {5, 15, 60, 240, 1440} */
+            std::map<std::string, std::vector<uint32_t>> symbol_timeframes; /**< Старшие таймфреймы отдельных символов (по полному имени символа) вместо timeframes */
+            TimeframeCallback timeframe_callback = nullptr; /**< Функция обработки событий старших таймфреймов */
+            std::vector<MtIndicatorSpec> indicators;        /**< Индикаторы, которые считаются по барам M1 всех символов */
+            IndicatorCallback indicator_callback = nullptr; /**< Функция обработки значений индикаторов */
+            size_t retention_bars = 0;      /**< Максимальное количество баров символа в памяти, 0 - без ограничения */
+            uint32_t retention_hours = 0;   /**< Максимальная глубина истории символа в часах, 0 - без ограничения */
+            SpillCallback spill_callback = nullptr; /**< Функция, которая получает вытесненные из памяти бары */
+            std::string journal_path;       /**< Папка журнала баров, пустая строка - журнал выключен */
+            std::string record_path;        /**< Папка записи потока байтов соединений, пустая строка - запись выключена */
+            std::string shm_name;           /**< Имя сегмента разделяемой памяти для читателей MtShmSubscriber, например "/mt-bridge", пустая строка - шина выключена */
+            uint32_t shm_capacity = 65536;  /**< Емкость кольца сообщений шины */
+            uint32_t shm_max_symbols = 1024;    /**< Максимальное количество символов шины */
+            uint32_t rebroadcast_port = 0;  /**< Порт ретрансляции состояний символов подписчикам, 0 - ретрансляция выключена */
+            std::string rebroadcast_address = "127.0.0.1";  /**< Адрес порта ретрансляции */
+            size_t rebroadcast_queue_size = 4096;   /**< Емкость очереди подписчика, при переполнении передаются только последние состояния символов */
+            std::shared_ptr<MtClock> clock; /**< Часы моста, по умолчанию часы компьютера */
+            OffsetEstimatorFactory offset_estimator = nullptr;  /**< Оценщик смещения времени сервера, по умолчанию MtEdgeOffsetEstimator */
+            uint32_t callback_fallback_ms = 100;    /**< Через сколько миллисекунд после начала секунды вызвать callback, если кадр с новой секундой так и не пришел */
+            size_t tick_stream_capacity = 0;        /**< Емкость очереди потока тиков, 0 - поток тиков выключен */
+            MtTickOverflow tick_overflow = MtTickOverflow::DROP_OLDEST; /**< Что делать, если очередь потока тиков переполнена */
+            TickCallback tick_callback = nullptr;   /**< Функция обработки событий NEW_RAW_TICK. Если задана, очередь читает поток моста */
+            bool is_load_candles = false;           /**< Разрешить load_candles (только для замеров и проверки стратегий без терминала) */
+
+            Config() {};
+
+            Config(
+                    const uint32_t p,
+                    const uint32_t n = 1440,
+                    Callback c = nullptr) :
+                port(p), number_bars(n), callback(c) {
+            };
+        };
+
     private:
-        std::future<void> server_future;    /**< Поток сервера */
+        std::vector<std::future<void>> server_futures; /**< Потоки сервера (пул потоков ввода-вывода) */
         std::future<void> callback_future;
 
-        const uint32_t MT_BRIDGE_MAX_VERSION = 1;
+        const uint32_t MT_BRIDGE_MAX_VERSION = 2;
 
         const uint64_t SECONDS_IN_MINUTE = 60;
+        const uint64_t SECONDS_IN_HOUR = 3600;
+
+        const char TERMINAL_NAMESPACE_SEPARATOR = ':';
 
         std::atomic<bool> is_mt_connected;  /**< Флаг установленного соединения */
+        std::atomic<bool> is_candles_loaded;/**< Бары загружены методом load_candles */
         std::atomic<bool> is_error;
         std::atomic<uint32_t> num_symbol;       /**< Количество символов */
-        std::atomic<uint32_t> mt_bridge_version;/**< Версия MT-Bridge для metatrader */
-        std::atomic<uint64_t> hist_init_len;    /**< Глубина исторических данных */
         std::vector<std::string> symbol_list;   /**< Список символов */
         std::map<std::string,uint32_t> symbol_name_to_index;
+        std::vector<uint8_t> terminal_symbols;  /**< Символ зарегистрировал терминал (под symbol_list_mutex) */
         std::mutex symbol_list_mutex;
+        std::vector<std::unique_ptr<MtSymbolTable>> symbol_tables; /**< Все построенные таблицы имен (под symbol_list_mutex), читатель может еще держать старую таблицу */
+        std::atomic<const MtSymbolTable*> symbol_table;     /**< Текущая таблица имен для поиска без блокировки */
 
-        std::vector<double> symbol_bid; /**< Массив цены bid тиков символов */
-        std::vector<double> symbol_ask; /**< Массив цены ask тиков символов */
-        std::vector<uint64_t> symbol_timestamp;
-        std::mutex symbol_tick_mutex;
+        MtStableArray<MtSeqlock<MtTick>> symbol_ticks; /**< Массив тиков символов (bid, ask и метка времени) */
 
-        std::vector<std::vector<CANDLE_TYPE>> array_candles;
+        std::vector<MtCandleStore<CANDLE_TYPE>> array_candles; /**< Бары символов с индексом по минутам */
+        std::vector<std::unique_ptr<MtCandleJournal>> journals; /**< Журналы закрытых баров символов (под array_candles_mutex) */
+        std::vector<std::vector<MtTimeframeAggregator<CANDLE_TYPE>>> array_timeframes; /**< Старшие таймфреймы символов (под array_candles_mutex) */
+        std::vector<uint32_t> all_timeframes;   /**< Все старшие таймфреймы по возрастанию */
+        MtIndicatorPipeline indicators;         /**< Состояние индикаторов символов (под array_candles_mutex) */
+        std::unique_ptr<MtShmPublisher> shm_publisher;  /**< Шина в разделяемой памяти (под array_candles_mutex) */
         std::mutex array_candles_mutex;
 
-        std::atomic<uint64_t> server_timestamp; /**< Метка времени сервера */
-        std::atomic<uint64_t> last_server_timestamp;
-
         std::atomic<bool> is_stop_command;      /**< Команда закрытия соединения */
+        std::atomic<uint64_t> bytes_processed;  /**< Количество полученных и разобранных байтов всех соединений */
+        std::shared_ptr<MtClock> clock;
+
+        /* события потока чтения для потока callback */
+        std::mutex event_mutex;
+        std::condition_variable event_cv;
+        uint64_t frame_server_timestamp = 0;    /**< Самая поздняя метка времени сервера среди декодированных кадров */
+        std::chrono::steady_clock::time_point frame_time;   /**< Время обновления хранилища баров кадром с самой поздней меткой времени сервера */
+        bool is_callback_waiting = false;       /**< Поток callback ждет событие */
+        bool is_callback_started = false;       /**< Поток callback передал исторические данные и ждет новые секунды */
+        uint64_t callback_timestamp = 0;        /**< Метка времени последнего события NEW_TICK */
+        double callback_fallback_time = 0;      /**< Время сервера, когда сработает таймер callback */
+
+        /* замер задержки от декодирования кадра до вызова callback */
+        std::atomic<double> last_callback_latency;
+        std::atomic<double> max_callback_latency;
+        std::atomic<double> sum_callback_latency;
+        std::atomic<uint64_t> count_callback_latency;
+
+        /* метрики этапов прохождения кадра по монотонным часам */
+        MtLatencyHistogram receive_to_decode_histogram;
+        MtLatencyHistogram decode_to_store_histogram;
+        MtLatencyHistogram store_to_callback_histogram;
+        MtLatencyHistogram callback_histogram;
+        MtLatencyHistogram lock_wait_histogram;
+        MtLatencyHistogram reconnect_gap_histogram;
+        std::atomic<uint64_t> num_frames;
+        std::atomic<uint64_t> num_connections;
+        std::atomic<uint64_t> num_reconnects;
+        std::atomic<uint64_t> num_resumes;
+        std::atomic<uint64_t> num_callbacks;
+
+        /* поток тиков: потоки чтения пишут тики в очередь, пользователь или поток моста их читает */
+        std::unique_ptr<MtSpscQueue<MtRawTick>> tick_queue;
+        std::mutex tick_producer_mutex;             /**< Нужен, только если в очередь пишут несколько потоков ввода-вывода */
+        bool is_tick_producer_lock = false;
+        std::mutex tick_mutex;
+        std::condition_variable tick_cv;
+        std::atomic<bool> is_tick_consumer_waiting;
+        std::future<void> tick_future;
+
+        /** \brief Разбудить читателя потока тиков
+         */
+        inline void notify_tick_consumer() {
+            if(!is_tick_consumer_waiting) return;
+            {
+                std::lock_guard<std::mutex> lock(tick_mutex);
+            }
+            tick_cv.notify_one();
+        }
 
-        /** \brief Класс соединения
+        /** \brief Сообщить потоку callback о декодированном кадре
+         * \param timestamp Метка времени сервера кадра с учетом часового пояса
+         * \param store_time Время обновления хранилища баров
+         * \param is_state_changed Изменилось состояние соединения
+         */
+        void notify_frame(
+                const uint64_t timestamp,
+                const std::chrono::steady_clock::time_point &store_time,
+                const bool is_state_changed) {
+            bool is_notify = is_state_changed;
+            {
+                std::lock_guard<std::mutex> lock(event_mutex);
+                if(timestamp > frame_server_timestamp) {
+                    frame_server_timestamp = timestamp;
+                    frame_time = store_time;
+                    is_notify = true;
+                }
+            }
+            if(is_notify) event_cv.notify_all();
+        }
+
+        /** \brief Разбудить все ожидающие потоки
+         */
+        void notify_all() {
+            {
+                std::lock_guard<std::mutex> lock(event_mutex);
+            }
+            event_cv.notify_all();
+        }
+
+        /** \brief Учесть задержку вызова callback
+         * \param latency Задержка в секундах
          */
-        class MtConnection {
-        private:
-            boost::asio::io_service mt_io_service;
-            tcp::acceptor mt_acceptor;
-            tcp::socket mt_socket;
+        void add_callback_latency(const double latency) {
+            last_callback_latency = latency;
+            if(latency > max_callback_latency) max_callback_latency = latency;
+            sum_callback_latency = sum_callback_latency + latency;
+            ++count_callback_latency;
+        }
+
+        /** \brief Состояние терминала
+         *
+         * Терминал занимает слот на время соединения. Метка времени сервера
+         * и смещения времени у каждого терминала (брокера) свои
+         */
+        class Terminal {
         public:
+            std::string name;                       /**< Имя терминала */
+            std::string terminal_id;                /**< Имя, которое передает советник, за ним закреплен слот (под terminals_mutex) */
+            bool is_identified = false;             /**< К слоту подключался терминал с именем (под terminals_mutex) */
+            uint64_t occupy_number = 0;             /**< Номер занятия слота, по нему закрытое соединение узнает, что слот уже передан новому (под terminals_mutex) */
+            std::atomic<bool> is_busy;              /**< Слот занят соединением */
+            std::atomic<bool> is_connected;         /**< Исторические данные получены, соединение установлено */
+            std::atomic<uint32_t> mt_bridge_version;/**< Версия MT-Bridge для metatrader */
+            std::atomic<uint64_t> hist_init_len;    /**< Глубина исторических данных */
+            std::atomic<uint64_t> server_timestamp; /**< Метка времени сервера */
+            std::atomic<uint64_t> last_server_timestamp;
+            std::atomic<uint64_t> num_connections;  /**< Количество соединений терминала */
+
+            std::unique_ptr<MtOffsetEstimator> offset_estimator;    /**< Оценщик смещения метки времени (поток чтения) */
+            MtSeqlock<MtOffsetModel> offset_model;                  /**< Модель смещения метки времени для всех потоков */
+            std::atomic<int64_t> offset_timezone;           /**< Смещение метки времени из-за часового пояса (это значение надо прибавлять к времени сервера) */
+
+            /* сессия последнего соединения, нужна для восстановления сессии при переподключении */
+            uint64_t session_id = 0;                        /**< Идентификатор сессии советника, 0 - советник его не передает */
+            std::vector<std::string> symbol_names;          /**< Имена символов в терминале */
+            std::vector<uint32_t> symbol_indices;           /**< Индексы символов в мосте */
+            std::chrono::steady_clock::time_point disconnect_time;  /**< Время разрыва последнего соединения */
+
+            Terminal(const std::string &terminal_name, std::unique_ptr<MtOffsetEstimator> estimator) :
+                    name(terminal_name), offset_estimator(std::move(estimator)) {
+                is_busy = false;
+                is_connected = false;
+                mt_bridge_version = 0;
+                hist_init_len = 0;
+                server_timestamp = 0;
+                last_server_timestamp = 0;
+                num_connections = 0;
+                offset_timezone = 0;
+            }
 
-            /** \brief Прочитать string
-             * \return Строка
+            /** \brief Сбросить замер смещения метки времени
              */
-            std::string read_string() {
-                char data[sizeof(char)*32];
-                boost::asio::read(mt_socket, boost::asio::buffer(data, sizeof(char)*32));
-                size_t copy_bytes = strnlen(data, sizeof(char)*32);
-                return std::string(data, copy_bytes);
+            void reset_offset_timestamp() {
+                offset_estimator->reset();
+                offset_model.store(offset_estimator->get_model());
             }
 
-            /** \brief Прочитать uint32_t
-             * \return значение числа типа uint32_t
+            /** \brief Получить смещение метки времени
+             * \param pc_time Время компьютера
+             * \return Смещение метки времени сервера относительно времени компьютера
              */
-            uint32_t read_uint32() {
-                uint8_t data[sizeof(uint32_t)];
-                boost::asio::read(mt_socket, boost::asio::buffer(data, sizeof(uint32_t)));
-                return ((uint32_t*)&data)[0];
+            inline double get_offset_timestamp(const double pc_time) const {
+                return offset_model.load().get_offset(pc_time);
             }
+        };
+
+        std::vector<std::unique_ptr<Terminal>> terminals;   /**< Слоты терминалов */
+        std::mutex terminals_mutex;
+        bool use_terminal_namespace = false;
+
+        Config config;  /**< Настройки моста */
 
-            /** \brief Прочитать double
-             * \return значение числа типа double
+        /** \brief Класс соединения
+         *
+         * Соединение читает данные асинхронно и разбирает протокол советника
+         * по мере поступления байтов в буфер. Версия протокола определяется
+         * по первым четырем байтам соединения
+         */
+        class MtSession : public std::enable_shared_from_this<MtSession> {
+        public:
+
+            /// Состояния разбора протокола
+            enum class State {
+                READ_VERSION,
+                READ_NUM_SYMBOL,
+                READ_SYMBOL_NAMES,
+                READ_HIST_LEN,
+                READ_FRAMES,
+                READ_FRAME_HEADER,  /**< Протокол версии 2, заголовок кадра */
+                READ_FRAME_PAYLOAD, /**< Протокол версии 2, данные кадра */
+            };
+
+            MetatraderBridge *bridge;
+            tcp::socket socket;
+            MtReadBuffer buffer;
+            State state = State::READ_VERSION;
+            int32_t terminal_index = -1;            /**< Слот терминала, -1 - заголовок соединения еще не получен */
+            uint64_t occupy_number = 0;             /**< Номер занятия слота терминала этим соединением */
+            std::mutex session_mutex;               /**< Разбор данных и операции с сокетом после запуска чтения */
+            bool is_replaced = false;               /**< Слот передан новому соединению того же терминала (под session_mutex) */
+            uint32_t mt_bridge_version = 0;         /**< Версия MT-Bridge для metatrader */
+            uint32_t num_symbol = 0;
+            uint64_t read_len = 0;
+            std::vector<std::string> symbol_names;  /**< Имена символов в терминале */
+            std::vector<uint32_t> symbol_indices;   /**< Индексы символов в мосте */
+            std::vector<MtSymbolRecord> records;    /**< Записи символов последнего кадра в том виде, в котором их передал терминал */
+            std::vector<uint32_t> changed_symbols;  /**< Номера символов, которые изменились в последнем кадре */
+            MtFrameHeader frame_header;             /**< Заголовок текущего кадра (протокол версии 2) */
+            uint32_t next_sequence = 0;             /**< Ожидаемый номер следующего кадра (протокол версии 2) */
+            std::vector<uint8_t> write_buffer;      /**< Кадр моста, который передается советнику */
+            std::unique_ptr<MtWireRecorder> recorder;   /**< Запись потока байтов соединения */
+            uint32_t write_sequence = 0;            /**< Номер следующего кадра моста */
+            bool is_resume = false;                 /**< Сессия восстановлена, данные символов сохранены */
+            std::chrono::steady_clock::time_point receive_time; /**< Время получения последнего блока байтов из сокета */
+            double connect_time = 0;                /**< Время подключения */
+
+            MtSession(MetatraderBridge *b, tcp::socket s) :
+                bridge(b), socket(std::move(s)) {
+                connect_time = bridge->get_ftimestamp();
+            }
+
+            ~MtSession() {
+                bridge->close_session(*this);
+            }
+
+            /** \brief Получить количество байтов, нужное для следующего шага разбора
              */
-            double read_double() {
-                uint8_t data[sizeof(double)];
-                boost::asio::read(mt_socket, boost::asio::buffer(data, sizeof(double)));
-                return ((double*)&data)[0];
+            size_t get_required_size() const {
+                switch(state) {
+                case State::READ_VERSION:
+                case State::READ_NUM_SYMBOL:
+                case State::READ_HIST_LEN:
+                    return sizeof(uint32_t);
+                case State::READ_SYMBOL_NAMES:
+                    return MT_BRIDGE_SYMBOL_NAME_SIZE;
+                case State::READ_FRAMES:
+                    return get_frame_size(num_symbol);
+                case State::READ_FRAME_HEADER:
+                    return MT_BRIDGE_FRAME_HEADER_SIZE;
+                case State::READ_FRAME_PAYLOAD:
+                    return frame_header.length;
+                };
+                return 0;
             }
 
-            /** \brief Прочитать uint64_t
-             * \return значение числа типа uint64_t
+            /** \brief Проверить, что ошибка означает обычное закрытие соединения
+             *
+             * Советник закрывает соединение при остановке или переподключении,
+             * а мост - при остановке, поэтому такие ошибки не выводятся
+             * \param ec Код ошибки
+             * \return Вернет true, если соединение просто закрыто
              */
-            uint64_t read_uint64() {
-                uint8_t data[sizeof(uint64_t)];
-                boost::asio::read(mt_socket, boost::asio::buffer(data, sizeof(uint64_t)));
-                return ((uint64_t*)&data)[0];
+            static bool is_disconnect_error(const boost::system::error_code &ec) {
+                return ec == boost::asio::error::operation_aborted ||
+                    ec == boost::asio::error::eof ||
+                    ec == boost::asio::error::connection_reset;
             }
 
-            MtConnection(const uint32_t port) :
-                    mt_acceptor(mt_io_service, tcp::endpoint(tcp::v4(), port)),
-                    mt_socket(mt_io_service) {
-                mt_acceptor.accept(mt_socket);
+            /** \brief Передать кадр советнику (протокол версии 2)
+             *
+             * Мост передает советнику только короткие служебные кадры,
+             * поэтому следующий кадр можно передать только после предыдущего
+             * \param type Тип кадра
+             * \param payload Данные кадра
+             */
+            void write_frame(const MtFrameType type, const std::vector<uint8_t> &payload) {
+                write_buffer.clear();
+                encode_frame_header(write_buffer, MtFrameHeader(type, write_sequence++, payload.size()));
+                write_buffer.insert(write_buffer.end(), payload.begin(), payload.end());
+                auto self(this->shared_from_this());
+                boost::asio::async_write(socket, boost::asio::buffer(write_buffer),
+                        [this, self](const boost::system::error_code &ec, std::size_t /*bytes*/) {
+                    if(ec && !is_disconnect_error(ec)) {
+                        std::cerr << "mt-bridge server error: " << ec.message() << std::endl;
+                    }
+                });
+            }
+
+            void start() {
+                auto self(this->shared_from_this());
+                const size_t required_size = get_required_size();
+                socket.async_read_some(buffer.prepare(required_size),
+                        [this, self](const boost::system::error_code &ec, std::size_t bytes) {
+                    /* соединение может закрыть новое соединение того же терминала */
+                    std::lock_guard<std::mutex> lock(session_mutex);
+                    if(ec || bridge->is_stop_command || is_replaced) {
+                        if(ec && !is_disconnect_error(ec)) {
+                            std::cerr << "mt-bridge server error: " << ec.message() << std::endl;
+                        }
+                        return;
+                    }
+                    receive_time = std::chrono::steady_clock::now();
+                    buffer.commit(bytes);
+                    if(recorder) recorder->write(bridge->get_ftimestamp(), buffer.data() + buffer.size() - bytes, bytes);
+                    try {
+                        while(buffer.size() >= get_required_size()) {
+                            buffer.consume(bridge->process_session(*this, buffer.data()));
+                        }
+                        bridge->bytes_processed += bytes;
+                    } catch (std::exception& e) {
+                        std::cerr << "mt-bridge server error: " << e.what() << std::endl;
+                        return;
+                    } catch (const char *e) {
+                        std::cerr << "mt-bridge server error: " << e << std::endl;
+                        return;
+                    } catch (...) {
+                        std::cerr << "mt-bridge server error" << std::endl;
+                        return;
+                    }
+                    start();
+                });
             }
         };
 
-        void init_historical_data(
-                std::vector<std::map<std::string, CANDLE_TYPE>> &candles,
-                const uint64_t date_timestamp,
-                const uint32_t number_bars) {
-            const int64_t first_timestamp = (date_timestamp / SECONDS_IN_MINUTE) * SECONDS_IN_MINUTE;
-            const int64_t start_timestamp = first_timestamp - (number_bars - 1) * SECONDS_IN_MINUTE;
+        boost::asio::io_context io_context;
+        tcp::acceptor mt_acceptor;
+        std::unique_ptr<boost::asio::steady_timer> accept_timer;
+        std::unique_ptr<MtRebroadcastServer> rebroadcast_server;
+        std::vector<std::weak_ptr<MtSession>> sessions;     /**< Открытые соединения (под terminals_mutex) */
+
+        /** \brief Открыть порт и начать принимать соединения
+         *
+         * Если порт занят, повторяем попытку каждую секунду
+         * \param port Номер порта
+         */
+        void start_server(const uint32_t port) {
+            try {
+                tcp::acceptor acceptor(io_context, tcp::endpoint(tcp::v4(), port));
+                mt_acceptor = std::move(acceptor);
+                start_accept();
+            } catch (std::exception& e) {
+                std::cerr << "mt-bridge server error: " << e.what() << std::endl;
+                const uint32_t DELAY_WAIT = 1000;
+                accept_timer.reset(new boost::asio::steady_timer(io_context));
+                accept_timer->expires_after(std::chrono::milliseconds(DELAY_WAIT));
+                accept_timer->async_wait([this, port](const boost::system::error_code &ec) {
+                    if(ec || is_stop_command) return;
+                    start_server(port);
+                });
+            }
+        }
+
+        /** \brief Принять следующее соединение
+         */
+        void start_accept() {
+            mt_acceptor.async_accept([this](const boost::system::error_code &ec, tcp::socket socket) {
+                if(is_stop_command || ec == boost::asio::error::operation_aborted) return;
+                if(!ec) {
+                    /* слот терминала выбирается после заголовка соединения */
+                    socket.set_option(tcp::no_delay(true));
+                    socket.set_option(boost::asio::socket_base::keep_alive(true));
+                    auto session = std::make_shared<MtSession>(this, std::move(socket));
+                    {
+                        std::lock_guard<std::mutex> lock(terminals_mutex);
+                        size_t n = 0;
+                        for(size_t i = 0; i < sessions.size(); ++i) {
+                            if(!sessions[i].expired()) sessions[n++] = sessions[i];
+                        }
+                        sessions.resize(n);
+                        sessions.push_back(session);
+                    }
+                    if(!config.record_path.empty()) session->recorder.reset(new MtWireRecorder());
+                    session->start();
+                } else {
+                    std::cerr << "mt-bridge server error: " << ec.message() << std::endl;
+                }
+                start_accept();
+            });
+        }
+
+        /** \brief Закрыть порт и соединения
+         *
+         * Вызывается, когда потоки пула ввода-вывода уже остановлены.
+         * Незавершенные операции завершаются с ошибкой operation_aborted,
+         * их обработчики выполняются здесь же и освобождают соединения,
+         * поэтому остановка моста не ждет терминалы и подписчиков
+         */
+        void stop_server() {
+            boost::system::error_code ignored_ec;
+            mt_acceptor.close(ignored_ec);
+            if(accept_timer) accept_timer->cancel(ignored_ec);
+            if(rebroadcast_server) rebroadcast_server->close();
+            std::vector<std::shared_ptr<MtSession>> active_sessions;
+            {
+                std::lock_guard<std::mutex> lock(terminals_mutex);
+                for(size_t i = 0; i < sessions.size(); ++i) {
+                    std::shared_ptr<MtSession> session = sessions[i].lock();
+                    if(session) active_sessions.push_back(session);
+                }
+            }
+            for(size_t i = 0; i < active_sessions.size(); ++i) {
+                active_sessions[i]->socket.close(ignored_ec);
+            }
+            active_sessions.clear();
+            try {
+                io_context.restart();
+                io_context.poll();
+            } catch (std::exception& e) {
+                std::cerr << "mt-bridge server error: " << e.what() << std::endl;
+            } catch (...) {
+                std::cerr << "mt-bridge server error" << std::endl;
+            }
+        }
+
+        /** \brief Начать запись потока байтов соединения в файл
+         *
+         * Файл записи получает имя терминала и время подключения в миллисекундах.
+         * Байты, полученные до выбора слота терминала, уже лежат в записи
+         * \param session Соединение
+         */
+        void start_recording(MtSession &session) {
+            const std::string file_name = config.record_path + "/" +
+                terminals[session.terminal_index]->name + "-" +
+                std::to_string((uint64_t)(session.connect_time * 1000.0)) + ".mtbr";
+            if(!session.recorder->open(file_name)) {
+                std::cerr << "mt-bridge record error: failed to open " << file_name << std::endl;
+                session.recorder.reset();
+            }
+        }
+
+        /** \brief Найти слот терминала
+         *
+         * Терминал, который передал имя, всегда получает один и тот же слот:
+         * слот с этим именем из Config::terminal_names или слот, который
+         * он занял при первом подключении. Советник, который передал
+         * идентификатор сессии, получает слот своей прошлой сессии, чтобы
+         * ее можно было восстановить. Такой слот возвращается, даже если
+         * он еще занят старым соединением: терминал переподключился раньше,
+         * чем мост узнал о разрыве. Анонимный советник (протокол
+         * версии 1 или советник без имени) получает первый свободный слот,
+         * к которому еще не подключался терминал с именем
+         * \param terminal_id Имя, которое передал советник, или пустая строка
+         * \param session_id Идентификатор сессии советника, 0 - советник его не передал
+         * \return Индекс терминала или -1, если свободных слотов нет
+         */
+        int32_t find_terminal(const std::string &terminal_id, const uint64_t session_id) {
+            if(!terminal_id.empty()) {
+                for(size_t t = 0; t < terminals.size(); ++t) {
+                    if(terminals[t]->terminal_id == terminal_id) return t;
+                }
+            }
+            if(session_id != 0) {
+                for(size_t t = 0; t < terminals.size(); ++t) {
+                    const Terminal &terminal = *terminals[t];
+                    if(!terminal.is_identified && terminal.session_id == session_id) return t;
+                }
+            }
+            /* сначала слоты, к которым еще никто не подключался */
+            for(size_t t = 0; t < terminals.size(); ++t) {
+                const Terminal &terminal = *terminals[t];
+                if(!terminal.is_busy && terminal.terminal_id.empty() && terminal.num_connections == 0) return t;
+            }
+            for(size_t t = 0; t < terminals.size(); ++t) {
+                const Terminal &terminal = *terminals[t];
+                if(!terminal.is_busy && terminal.terminal_id.empty()) return t;
+            }
+            if(!terminal_id.empty()) return -1;
+            /* слоты из Config::terminal_names, которые еще не заняли их терминалы */
+            for(size_t t = 0; t < terminals.size(); ++t) {
+                const Terminal &terminal = *terminals[t];
+                if(!terminal.is_busy && !terminal.is_identified) return t;
+            }
+            return -1;
+        }
+
+        /** \brief Занять слот терминала
+         *
+         * Если слот еще занят старым соединением того же терминала
+         * (например, соединение оборвалось без FIN), старое соединение
+         * закрывается, а слот переходит новому
+         * \param session Соединение, заголовок которого уже получен
+         * \param terminal_id Имя, которое передал советник, или пустая строка
+         * \param session_id Идентификатор сессии советника, 0 - советник его не передал
+         * \return Терминал
+         */
+        Terminal &occupy_terminal(MtSession &session, const std::string &terminal_id, const uint64_t session_id) {
+            std::shared_ptr<MtSession> stale_session;
+            {
+                std::lock_guard<std::mutex> lock(terminals_mutex);
+                const int32_t terminal_index = find_terminal(terminal_id, session_id);
+                if(terminal_index < 0)
+                    throw("Error! No free terminal slots");
+                Terminal &terminal = *terminals[terminal_index];
+                if(terminal.is_busy) {
+                    for(size_t i = 0; i < sessions.size() && !stale_session; ++i) {
+                        std::shared_ptr<MtSession> other = sessions[i].lock();
+                        if(other && other.get() != &session &&
+                            other->terminal_index == terminal_index &&
+                            other->occupy_number == terminal.occupy_number) stale_session = other;
+                    }
+                    disconnect_terminal(terminal);
+                }
+                terminal.is_busy = true;
+                session.occupy_number = ++terminal.occupy_number;
+                if(!terminal_id.empty()) {
+                    terminal.terminal_id = terminal_id;
+                    terminal.is_identified = true;
+                }
+                terminal.mt_bridge_version = session.mt_bridge_version;
+                session.terminal_index = terminal_index;
+            }
+            if(stale_session) {
+                /* ждем, пока старое соединение дочитает текущий блок, и закрываем его */
+                std::lock_guard<std::mutex> lock(stale_session->session_mutex);
+                stale_session->is_replaced = true;
+                boost::system::error_code ignored_ec;
+                stale_session->socket.close(ignored_ec);
+            }
+            if(session.recorder) start_recording(session);
+            return *terminals[session.terminal_index];
+        }
+
+        /** \brief Закрыть соединение и освободить слот терминала
+         * \param session Соединение
+         */
+        void close_session(MtSession &session) {
+            if(session.terminal_index < 0) return;
+            std::lock_guard<std::mutex> lock(terminals_mutex);
+            Terminal &terminal = *terminals[session.terminal_index];
+            /* слот уже передан новому соединению того же терминала */
+            if(terminal.occupy_number != session.occupy_number) return;
+            disconnect_terminal(terminal);
+            terminal.is_busy = false;
+        }
+
+        /** \brief Отметить разрыв соединения терминала
+         *
+         * Перед вызовом нужно захватить terminals_mutex
+         * \param terminal Терминал
+         */
+        void disconnect_terminal(Terminal &terminal) {
+            if(terminal.is_connected) terminal.disconnect_time = std::chrono::steady_clock::now();
+            terminal.is_connected = false;
+            bool is_connected = false;
+            for(size_t t = 0; t < terminals.size(); ++t) {
+                if(terminals[t]->is_connected) is_connected = true;
+            }
+            is_mt_connected = is_connected;
+            if(!is_connected) is_error = true;
+            notify_all();
+        }
+
+        /** \brief Зарегистрировать символ
+         *
+         * Индекс символа в мосте не меняется при переподключении терминала,
+         * при этом данные символа очищаются
+         * \param symbol_name Полное имя символа
+         * \param is_terminal Символ регистрирует терминал
+         * \return Индекс символа
+         */
+        uint32_t register_symbol(const std::string &symbol_name, const bool is_terminal = true) {
             std::lock_guard<std::mutex> lock(symbol_list_mutex);
-            candles.resize(number_bars);
-            for(uint32_t symbol_index = 0;
-                symbol_index < num_symbol;
-                ++symbol_index) {
-                std::string symbol_name = symbol_list[symbol_index];
-                for(size_t i = 0; i < candles.size(); ++i) {
-                    candles[i][symbol_name].timestamp = i * SECONDS_IN_MINUTE + start_timestamp;
+            auto it = symbol_name_to_index.find(symbol_name);
+            if(it != symbol_name_to_index.end()) {
+                const uint32_t symbol_index = it->second;
+                if(is_terminal) terminal_symbols[symbol_index] = 1;
+                symbol_ticks[symbol_index].store(MtTick());
+                std::lock_guard<std::mutex> lock(array_candles_mutex);
+                array_candles[symbol_index].clear();
+                for(size_t i = 0; i < array_timeframes[symbol_index].size(); ++i) {
+                    array_timeframes[symbol_index][i].clear();
                 }
-                for(size_t i = 0; i < array_candles[symbol_index].size(); ++i) {
-                    const int64_t index = ((int64_t)array_candles[symbol_index][i].timestamp - start_timestamp) / (int64_t)SECONDS_IN_MINUTE;
-                    if(index < 0) continue;
-                    if(index >= number_bars) continue;
-                    candles[index][symbol_name] = array_candles[symbol_index][i];
+                indicators.reset_symbol(symbol_index);
+                load_journal(symbol_index);
+                return symbol_index;
+            }
+            const uint32_t symbol_index = symbol_list.size();
+            symbol_ticks.grow(symbol_index + 1);
+            {
+                std::lock_guard<std::mutex> lock(array_candles_mutex);
+                array_candles.push_back(MtCandleStore<CANDLE_TYPE>(
+                    config.retention_bars,
+                    (uint64_t)config.retention_hours * SECONDS_IN_HOUR));
+                array_timeframes.push_back(std::vector<MtTimeframeAggregator<CANDLE_TYPE>>());
+                const std::vector<uint32_t> timeframes = get_config_timeframes(symbol_name);
+                for(size_t i = 0; i < timeframes.size(); ++i) {
+                    array_timeframes.back().push_back(MtTimeframeAggregator<CANDLE_TYPE>(
+                        timeframes[i],
+                        config.retention_bars,
+                        (uint64_t)config.retention_hours * SECONDS_IN_HOUR));
+                }
+                indicators.add_symbol();
+                if(shm_publisher) shm_publisher->add_symbol(symbol_index, symbol_name);
+                if(rebroadcast_server) rebroadcast_server->add_symbol(symbol_index, symbol_name);
+                if(!config.journal_path.empty()) {
+                    journals.push_back(std::unique_ptr<MtCandleJournal>(new MtCandleJournal()));
+                    const std::string file_name = MtCandleJournal::get_file_name(config.journal_path, symbol_name);
+                    if(!journals.back()->open(file_name)) {
+                        std::cerr << "mt-bridge journal error: failed to open " << file_name << std::endl;
+                    }
+                    load_journal(symbol_index);
                 }
             }
+            symbol_list.push_back(symbol_name);
+            symbol_name_to_index[symbol_name] = symbol_index;
+            terminal_symbols.push_back(is_terminal ? 1 : 0);
+            num_symbol = symbol_list.size();
+            return symbol_index;
         }
 
-        /* реализуем замер смещения времени за 256 отсчетов */
-        const uint32_t array_offset_timestamp_size = 256;
-        std::array<double, 256> array_offset_timestamp; /**< Массив смещения метки времени */
-        uint8_t index_array_offset_timestamp = 0;       /**< Индекс элемента массива смещения метки времени */
-        uint32_t index_array_offset_timestamp_count = 0;
-        double last_offset_timestamp_sum = 0;
-        std::atomic<double> offset_timestamp;           /**< Смещение метки времени */
-        std::atomic<int64_t> offset_timezone;           /**< Смещение метки времени из-за часового пояса (это значение надо прибавлять к времени сервера) */
+        /** \brief Опубликовать таблицу имен символов
+         *
+         * Таблица строится заново, только если появились новые символы,
+         * то есть после подключения терминала с новыми символами
+         */
+        void publish_symbol_table() {
+            std::lock_guard<std::mutex> lock(symbol_list_mutex);
+            if(symbol_table.load(std::memory_order_relaxed)->size() == symbol_list.size()) return;
+            symbol_tables.push_back(std::unique_ptr<MtSymbolTable>(new MtSymbolTable(symbol_list)));
+            symbol_table.store(symbol_tables.back().get(), std::memory_order_release);
+        }
 
-        /** \brief Обновить смещение метки времени
+        /** \brief Найти символ по имени без блокировки
+         * \param symbol_name Полное имя символа
+         * \return Дескриптор символа
+         */
+        inline MtSymbolHandle find_symbol(const std::string &symbol_name) const {
+            return symbol_table.load(std::memory_order_acquire)->find(symbol_name);
+        }
+
+        /** \brief Загрузить бары символа из журнала
          *
-         * Данный метод использует оптимизированное скользящее среднее
-         * для выборки из 256 элеметов для нахождения смещения метки времени сервера
-         * относительно времени компьютера
-         * \param offset смещение метки времени
-         */
-        inline void update_offset_timestamp(const double offset) {
-            if(index_array_offset_timestamp_count != array_offset_timestamp_size) {
-                array_offset_timestamp[index_array_offset_timestamp] = offset;
-                index_array_offset_timestamp_count = (uint32_t)index_array_offset_timestamp + 1;
-                last_offset_timestamp_sum += offset;
-                offset_timestamp = last_offset_timestamp_sum / (double)index_array_offset_timestamp_count;
-                ++index_array_offset_timestamp;
+         * Перед вызовом нужно захватить array_candles_mutex.
+         * Загружаются только бары, которые поместятся в хранилище баров
+         * \param symbol_index Индекс символа
+         */
+        void load_journal(const uint32_t symbol_index) {
+            if(symbol_index >= journals.size() || !journals[symbol_index]->is_open()) return;
+            const MtCandleJournal &journal = *journals[symbol_index];
+            MtCandleStore<CANDLE_TYPE> &candles = array_candles[symbol_index];
+            uint64_t start = 0;
+            if(config.retention_bars != 0 && journal.size() > config.retention_bars) {
+                start = journal.size() - config.retention_bars;
+            }
+            for(uint64_t i = start; i < journal.size(); ++i) {
+                const CANDLE_TYPE candle = journal.get_candle<CANDLE_TYPE>(i);
+                candles.update(candle);
+                update_aggregates(symbol_index, candle);
+            }
+        }
+
+        /** \brief Получить старшие таймфреймы символа из настроек
+         * \param symbol_name Полное имя символа
+         * \return Таймфреймы в минутах по возрастанию, без M1 и повторов
+         */
+        std::vector<uint32_t> get_config_timeframes(const std::string &symbol_name) const {
+            auto it = config.symbol_timeframes.find(symbol_name);
+            return normalize_timeframes(it == config.symbol_timeframes.end() ? config.timeframes : it->second);
+        }
+
+        /** \brief Упорядочить таймфреймы
+         * \param timeframes Таймфреймы в минутах
+         * \return Таймфреймы по возрастанию, без M1 и повторов
+         */
+        static std::vector<uint32_t> normalize_timeframes(std::vector<uint32_t> timeframes) {
+            timeframes.erase(std::remove_if(timeframes.begin(), timeframes.end(), [](const uint32_t timeframe) {
+                return timeframe <= 1;
+            }), timeframes.end());
+            std::sort(timeframes.begin(), timeframes.end());
+            timeframes.erase(std::unique(timeframes.begin(), timeframes.end()), timeframes.end());
+            return timeframes;
+        }
+
+        /** \brief Обновить старшие таймфреймы и индикаторы символа баром M1
+         *
+         * Перед вызовом нужно захватить array_candles_mutex
+         * \param symbol_index Индекс символа
+         * \param candle Бар M1
+         */
+        inline void update_aggregates(const uint32_t symbol_index, const CANDLE_TYPE &candle) {
+            std::vector<MtTimeframeAggregator<CANDLE_TYPE>> &timeframes = array_timeframes[symbol_index];
+            for(size_t i = 0; i < timeframes.size(); ++i) {
+                timeframes[i].update(candle);
+            }
+            if(!indicators.empty()) indicators.update(symbol_index, candle);
+        }
+
+        /** \brief Опубликовать состояние символа в шине и подписчикам ретрансляции
+         *
+         * Перед вызовом нужно захватить array_candles_mutex
+         * \param symbol_index Индекс символа
+         * \param bid Цена bid
+         * \param ask Цена ask
+         * \param server_timestamp Метка времени сервера
+         * \param candle Бар M1
+         */
+        inline void publish_update(
+                const uint32_t symbol_index,
+                const double bid,
+                const double ask,
+                const uint64_t server_timestamp,
+                const CANDLE_TYPE &candle) {
+            MtShmMessage message;
+            message.event = MtShmEvent::UPDATE;
+            message.symbol_index = symbol_index;
+            message.bid = bid;
+            message.ask = ask;
+            message.open = candle.open;
+            message.high = candle.high;
+            message.low = candle.low;
+            message.close = candle.close;
+            message.volume = candle.volume;
+            message.server_timestamp = server_timestamp;
+            message.timestamp = candle.timestamp;
+            if(shm_publisher) shm_publisher->publish(message);
+            if(rebroadcast_server) rebroadcast_server->publish(message);
+        }
+
+        /** \brief Найти таймфрейм символа
+         *
+         * Перед вызовом нужно захватить array_candles_mutex
+         * \param symbol_index Индекс символа
+         * \param timeframe Таймфрейм в минутах
+         * \return Указатель на таймфрейм или nullptr, если у символа нет такого таймфрейма
+         */
+        inline const MtTimeframeAggregator<CANDLE_TYPE> *find_timeframe(
+                const uint32_t symbol_index,
+                const uint32_t timeframe) const {
+            const std::vector<MtTimeframeAggregator<CANDLE_TYPE>> &timeframes = array_timeframes[symbol_index];
+            for(size_t i = 0; i < timeframes.size(); ++i) {
+                if(timeframes[i].get_timeframe() == timeframe) return &timeframes[i];
+            }
+            return nullptr;
+        }
+
+        /** \brief Получить, сколько баров истории нужно передать советнику
+         *
+         * Если у всех символов терминала есть бары в журнале или сессия
+         * восстановлена, советнику достаточно передать бары новее самого
+         * старого из последних баров символов
+         * \param session Соединение
+         * \param hist_len Глубина исторических данных советника
+         * \return Количество баров истории
+         */
+        uint32_t get_missing_history(const MtSession &session, const uint32_t hist_len) {
+            if(journals.empty() && !session.is_resume) return hist_len;
+            uint64_t last_timestamp = 0;
+            {
+                std::lock_guard<std::mutex> lock(array_candles_mutex);
+                for(uint32_t s = 0; s < session.num_symbol; ++s) {
+                    const MtCandleStore<CANDLE_TYPE> &candles = array_candles[session.symbol_indices[s]];
+                    if(candles.empty()) return hist_len;
+                    const uint64_t timestamp = candles.back().timestamp;
+                    if(last_timestamp == 0 || timestamp < last_timestamp) last_timestamp = timestamp;
+                }
+            }
+            /* последний бар журнала тоже запросим, на случай если часы компьютера и сервера расходятся */
+            const uint64_t minute = get_timestamp() / SECONDS_IN_MINUTE;
+            const uint64_t last_minute = last_timestamp / SECONDS_IN_MINUTE;
+            if(minute <= last_minute) return std::min(hist_len, (uint32_t)1);
+            return (uint32_t)std::min((uint64_t)hist_len, minute - last_minute + 1);
+        }
+
+        /** \brief Начать прием кадров данных терминала
+         *
+         * Если терминал переподключился с той же сессией советника и тем же
+         * списком символов, сессия восстанавливается: бары, тики и смещение
+         * времени сервера сохраняются, и советнику достаточно передать
+         * пропущенные бары. Иначе данные символов терминала очищаются
+         * \param session Соединение
+         * \param terminal Терминал
+         * \param hist_len Глубина исторических данных
+         * \param session_id Идентификатор сессии советника, 0 - сессию не восстанавливать
+         */
+        void start_terminal(
+                MtSession &session,
+                Terminal &terminal,
+                const uint32_t hist_len,
+                const uint64_t session_id = 0) {
+            session.is_resume = session_id != 0 &&
+                terminal.num_connections > 0 &&
+                terminal.session_id == session_id &&
+                terminal.symbol_names == session.symbol_names;
+            terminal.session_id = session_id;
+            terminal.hist_init_len = hist_len;
+            session.records.assign(session.num_symbol, MtSymbolRecord());
+            session.changed_symbols.reserve(session.num_symbol);
+            if(session.is_resume) {
+                session.symbol_indices = terminal.symbol_indices;
+                ++num_resumes;
                 return;
             }
-            /* находим скользящее среднее смещения метки времени сервера относительно компьютера */
-            last_offset_timestamp_sum = last_offset_timestamp_sum +
-                (offset - array_offset_timestamp[index_array_offset_timestamp]);
-            array_offset_timestamp[index_array_offset_timestamp++] = offset;
-            offset_timestamp = last_offset_timestamp_sum/
-                (double)array_offset_timestamp_size;
+            terminal.server_timestamp = 0;
+            terminal.last_server_timestamp = 0;
+            terminal.offset_timezone = 0;
+            terminal.reset_offset_timestamp();
+            session.symbol_indices.resize(session.num_symbol);
+            for(uint32_t s = 0; s < session.num_symbol; ++s) {
+                const std::string symbol_name = use_terminal_namespace ?
+                    (terminal.name + TERMINAL_NAMESPACE_SEPARATOR + session.symbol_names[s]) :
+                    session.symbol_names[s];
+                session.symbol_indices[s] = register_symbol(symbol_name);
+            }
+            terminal.symbol_names = session.symbol_names;
+            terminal.symbol_indices = session.symbol_indices;
+            publish_symbol_table();
+        }
+
+        /** \brief Обработать очередной шаг протокола
+         * \param session Соединение
+         * \param data Данные размером session.get_required_size()
+         * \return Количество обработанных байтов
+         */
+        size_t process_session(MtSession &session, const uint8_t *data) {
+            switch(session.state) {
+            case MtSession::State::READ_VERSION:
+                /* советник версии 2 начинает соединение с заголовка кадра */
+                if(decode_value<uint32_t>(data) == MT_BRIDGE_FRAME_MAGIC) {
+                    session.mt_bridge_version = MT_BRIDGE_FRAME_VERSION;
+                    session.state = MtSession::State::READ_FRAME_HEADER;
+                    return 0;
+                }
+                /* читаем версию эксперта для Metatrdaer */
+                session.mt_bridge_version = decode_value<uint32_t>(data);
+                if(session.mt_bridge_version >= MT_BRIDGE_FRAME_VERSION)
+                    throw("Error! Unsupported expert version for metatrader");
+                session.state = MtSession::State::READ_NUM_SYMBOL;
+                return sizeof(uint32_t);
+            case MtSession::State::READ_NUM_SYMBOL:
+                /* читаем количество символов */
+                session.num_symbol = decode_value<uint32_t>(data);
+                if(session.num_symbol == 0)
+                    throw("Error! Invalid list of currency pairs!");
+                session.symbol_names.reserve(session.num_symbol);
+                session.state = MtSession::State::READ_SYMBOL_NAMES;
+                return sizeof(uint32_t);
+            case MtSession::State::READ_SYMBOL_NAMES:
+                /* читаем имена символов */
+                session.symbol_names.push_back(std::string(
+                    (const char*)data,
+                    strnlen((const char*)data, MT_BRIDGE_SYMBOL_NAME_SIZE)));
+                if(session.symbol_names.size() == session.num_symbol)
+                    session.state = MtSession::State::READ_HIST_LEN;
+                return MT_BRIDGE_SYMBOL_NAME_SIZE;
+            case MtSession::State::READ_HIST_LEN:
+                /* читаем глубину истории для инициализации, советник версии 1 не передает имя терминала */
+                start_terminal(session, occupy_terminal(session, std::string(), 0), decode_value<uint32_t>(data));
+                session.state = MtSession::State::READ_FRAMES;
+                return sizeof(uint32_t);
+            case MtSession::State::READ_FRAMES:
+                process_frame(session, *terminals[session.terminal_index], data);
+                return get_frame_size(session.num_symbol);
+            case MtSession::State::READ_FRAME_HEADER:
+                process_frame_header(session, data);
+                session.state = MtSession::State::READ_FRAME_PAYLOAD;
+                return MT_BRIDGE_FRAME_HEADER_SIZE;
+            case MtSession::State::READ_FRAME_PAYLOAD:
+                process_frame_payload(session, data);
+                session.state = MtSession::State::READ_FRAME_HEADER;
+                return session.frame_header.length;
+            };
+            return 0;
+        }
+
+        /** \brief Обработать заголовок кадра протокола версии 2
+         *
+         * Любое нарушение (сигнатура, номер кадра, размер) означает потерю
+         * синхронизации, поэтому соединение закрывается
+         * \param session Соединение
+         * \param data Заголовок кадра
+         */
+        void process_frame_header(MtSession &session, const uint8_t *data) {
+            MtFrameHeader &header = session.frame_header;
+            decode_frame_header(data, header);
+            if(header.magic != MT_BRIDGE_FRAME_MAGIC)
+                throw("Error! Invalid frame signature");
+            if(header.version != MT_BRIDGE_FRAME_VERSION)
+                throw("Error! Unsupported frame version");
+            if(header.sequence != session.next_sequence)
+                throw("Error! Frame sequence number mismatch");
+            if(header.length > MT_BRIDGE_MAX_FRAME_LENGTH)
+                throw("Error! Frame is too large");
+            ++session.next_sequence;
+            const bool is_handshake = session.terminal_index < 0;
+            switch((MtFrameType)header.type) {
+            case MtFrameType::HANDSHAKE:
+                if(!is_handshake)
+                    throw("Error! Unexpected handshake frame");
+                if(header.length < 2 * sizeof(uint32_t))
+                    throw("Error! Invalid handshake frame length");
+                break;
+            case MtFrameType::SNAPSHOT:
+                if(is_handshake)
+                    throw("Error! Handshake frame expected");
+                if(header.length != get_frame_size(session.num_symbol))
+                    throw("Error! Invalid snapshot frame length");
+                break;
+            case MtFrameType::DELTA:
+                if(is_handshake)
+                    throw("Error! Handshake frame expected");
+                if(session.read_len == 0)
+                    throw("Error! Snapshot frame expected before delta frame");
+                if(header.length < get_min_delta_frame_size(session.num_symbol) ||
+                    header.length > get_max_delta_frame_size(session.num_symbol))
+                    throw("Error! Invalid delta frame length");
+                break;
+            default:
+                throw("Error! Unknown frame type");
+            };
+        }
+
+        /** \brief Обработать данные кадра протокола версии 2
+         * \param session Соединение
+         * \param data Данные кадра
+         */
+        void process_frame_payload(MtSession &session, const uint8_t *data) {
+            switch((MtFrameType)session.frame_header.type) {
+            case MtFrameType::HANDSHAKE: {
+                    /* повторный заголовок дописал бы имена к списку символов сессии */
+                    if(session.terminal_index >= 0 || !session.symbol_names.empty())
+                        throw("Error! Unexpected handshake frame");
+                    session.num_symbol = decode_value<uint32_t>(data);
+                    if(session.num_symbol == 0)
+                        throw("Error! Invalid list of currency pairs!");
+                    const size_t handshake_length =
+                        2 * sizeof(uint32_t) + (size_t)session.num_symbol * MT_BRIDGE_SYMBOL_NAME_SIZE;
+                    const uint32_t flags = session.frame_header.length > handshake_length ?
+                        decode_value<uint32_t>(data + handshake_length) : 0;
+                    size_t flags_length = 0;
+                    if(session.frame_header.length > handshake_length) {
+                        flags_length = sizeof(uint32_t);
+                        if(flags & MT_BRIDGE_HANDSHAKE_SESSION_ID) flags_length += sizeof(uint64_t);
+                        if(flags & MT_BRIDGE_HANDSHAKE_TERMINAL_NAME) flags_length += MT_BRIDGE_SYMBOL_NAME_SIZE;
+                    }
+                    if(session.frame_header.length != handshake_length + flags_length)
+                        throw("Error! Invalid handshake frame length");
+                    const uint8_t *name = data + sizeof(uint32_t);
+                    session.symbol_names.reserve(session.num_symbol);
+                    for(uint32_t s = 0; s < session.num_symbol; ++s) {
+                        session.symbol_names.push_back(std::string(
+                            (const char*)name,
+                            strnlen((const char*)name, MT_BRIDGE_SYMBOL_NAME_SIZE)));
+                        name += MT_BRIDGE_SYMBOL_NAME_SIZE;
+                    }
+                    const uint32_t hist_len = decode_value<uint32_t>(name);
+                    const uint8_t *option = name + 2 * sizeof(uint32_t);
+                    uint64_t session_id = 0;
+                    if(flags & MT_BRIDGE_HANDSHAKE_SESSION_ID) {
+                        session_id = decode_value<uint64_t>(option);
+                        option += sizeof(uint64_t);
+                    }
+                    std::string terminal_id;
+                    if(flags & MT_BRIDGE_HANDSHAKE_TERMINAL_NAME) {
+                        terminal_id = std::string((const char*)option, strnlen((const char*)option, MT_BRIDGE_SYMBOL_NAME_SIZE));
+                    }
+                    Terminal &terminal = occupy_terminal(session, terminal_id, session_id);
+                    start_terminal(session, terminal, hist_len, session_id);
+                    if(flags & MT_BRIDGE_HANDSHAKE_HISTORY_REQUEST) {
+                        /* советник ждет, сколько баров истории передать */
+                        const uint32_t history_len = get_missing_history(session, hist_len);
+                        terminal.hist_init_len = history_len;
+                        std::vector<uint8_t> payload(sizeof(uint32_t));
+                        std::memcpy(payload.data(), &history_len, sizeof(uint32_t));
+                        session.write_frame(MtFrameType::HISTORY_REQUEST, payload);
+                    }
+                }
+                break;
+            case MtFrameType::SNAPSHOT:
+                process_frame(session, *terminals[session.terminal_index], data);
+                break;
+            case MtFrameType::DELTA:
+                process_records(session, *terminals[session.terminal_index], decode_delta_frame(
+                    data, session.frame_header.length,
+                    session.records, session.changed_symbols));
+                break;
+            default:
+                break;
+            };
+        }
+
+        /** \brief Обработать кадр данных
+         * \param session Соединение
+         * \param terminal Терминал
+         * \param frame Кадр данных
+         */
+        void process_frame(MtSession &session, Terminal &terminal, const uint8_t *frame) {
+            const uint32_t session_num_symbol = session.num_symbol;
+
+            /* декодируем кадр данных за один проход */
+            session.changed_symbols.clear();
+            for(uint32_t s = 0; s < session_num_symbol; ++s) {
+                decode_symbol_record(frame + s * MT_BRIDGE_SYMBOL_RECORD_SIZE, session.records[s]);
+                session.changed_symbols.push_back(s);
+            }
+            process_records(session, terminal,
+                decode_value<uint64_t>(frame + session_num_symbol * MT_BRIDGE_SYMBOL_RECORD_SIZE));
+        }
+
+        /** \brief Сохранить записи изменившихся символов
+         * \param session Соединение
+         * \param terminal Терминал
+         * \param server_timestamp Метка времени сервера из кадра
+         */
+        void process_records(MtSession &session, Terminal &terminal, const uint64_t server_timestamp) {
+            const std::vector<MtSymbolRecord> &records = session.records;
+            const std::vector<uint32_t> &changed_symbols = session.changed_symbols;
+            const std::vector<uint32_t> &symbol_indices = session.symbol_indices;
+            const std::chrono::steady_clock::time_point decode_time = std::chrono::steady_clock::now();
+
+            /* в первом кадре найдем смещение метки времени из-за часового пояса,
+             * чтобы бары кадра сразу попали на одну сетку с барами журнала
+             */
+            if(session.read_len == 0) update_offset_timezone(terminal, server_timestamp);
+            const int64_t offset_timezone = terminal.offset_timezone;
+
+            /* сохраняем тики */
+            if(tick_queue && terminal.is_connected) {
+                /* передаем в поток тиков символы, у которых изменились bid или ask */
+                std::unique_lock<std::mutex> lock(tick_producer_mutex, std::defer_lock);
+                if(is_tick_producer_lock) lock.lock();
+                const double receive_time = get_ftimestamp();
+                const uint64_t tick_server_timestamp = server_timestamp + offset_timezone;
+                bool is_push = false;
+                for(size_t i = 0; i < changed_symbols.size(); ++i) {
+                    const MtSymbolRecord &r = records[changed_symbols[i]];
+                    const uint32_t symbol_index = symbol_indices[changed_symbols[i]];
+                    MtSeqlock<MtTick> &symbol_tick = symbol_ticks[symbol_index];
+                    const MtTick last_tick = symbol_tick.load();
+                    symbol_tick.store(MtTick(r.bid, r.ask, r.timestamp + offset_timezone));
+                    if(last_tick.bid == r.bid && last_tick.ask == r.ask) continue;
+                    tick_queue->push(
+                        MtRawTick(symbol_index, r.bid, r.ask, tick_server_timestamp, receive_time),
+                        config.tick_overflow);
+                    is_push = true;
+                }
+                if(is_push) notify_tick_consumer();
+            } else {
+                for(size_t i = 0; i < changed_symbols.size(); ++i) {
+                    const MtSymbolRecord &r = records[changed_symbols[i]];
+                    symbol_ticks[symbol_indices[changed_symbols[i]]].store(
+                        MtTick(r.bid, r.ask, r.timestamp + offset_timezone));
+                }
+            }
+
+            /* сохраняем бары */
+            std::chrono::steady_clock::time_point store_time;
+            {
+                const std::chrono::steady_clock::time_point lock_time = std::chrono::steady_clock::now();
+                std::lock_guard<std::mutex> lock(array_candles_mutex);
+                lock_wait_histogram.record(lock_time, std::chrono::steady_clock::now());
+                for(size_t i = 0; i < changed_symbols.size(); ++i) {
+                    const MtSymbolRecord &r = records[changed_symbols[i]];
+                    const uint32_t symbol_index = symbol_indices[changed_symbols[i]];
+                    const CANDLE_TYPE candle(r.open, r.high, r.low, r.close, r.volume, r.timestamp + offset_timezone);
+                    MtCandleStore<CANDLE_TYPE> &candles = array_candles[symbol_index];
+                    /* пришел бар новее последнего, значит последний бар закрыт */
+                    if(!journals.empty() && !candles.empty() && candles.back().timestamp < candle.timestamp) {
+                        journals[symbol_index]->append(candles.back());
+                    }
+                    candles.update(candle, [&](const CANDLE_TYPE &spilled_candle) {
+                        if(config.spill_callback != nullptr) config.spill_callback(symbol_index, spilled_candle);
+                    });
+                    update_aggregates(symbol_index, candle);
+                    if(shm_publisher || rebroadcast_server) publish_update(symbol_index, r.bid, r.ask, server_timestamp + offset_timezone, candle);
+                }
+                store_time = std::chrono::steady_clock::now();
+            }
+            receive_to_decode_histogram.record(session.receive_time, decode_time);
+            decode_to_store_histogram.record(decode_time, store_time);
+            ++num_frames;
+
+            /* запоминаем метку времени сервера */
+            terminal.server_timestamp = server_timestamp;
+
+            /* если метка времени поменялась, уточним смещение времени сервера */
+            if(terminal.last_server_timestamp != terminal.server_timestamp) {
+                terminal.last_server_timestamp = (uint64_t)terminal.server_timestamp;
+                update_offset_timestamp(terminal, server_timestamp, get_ftimestamp());
+            }
+
+            ++session.read_len;
+            bool is_state_changed = false;
+            if(session.read_len > terminal.hist_init_len && !terminal.is_connected) {
+                /* теперь мы вправе сказать, что соединение удалось */
+                terminal.is_connected = true;
+                if(terminal.num_connections++ > 0) {
+                    ++num_reconnects;
+                    reconnect_gap_histogram.record(terminal.disconnect_time, std::chrono::steady_clock::now());
+                }
+                ++num_connections;
+                is_error = false;
+                is_mt_connected = true;
+                is_state_changed = true;
+            }
+            if(terminal.is_connected) {
+                notify_frame(terminal.server_timestamp + terminal.offset_timezone, store_time, is_state_changed);
+            }
+        }
+
+        /** \brief Получить бар по метке времени
+         *
+         * Перед вызовом нужно захватить array_candles_mutex
+         * \param symbol_index Индекс символа
+         * \param timestamp Метка времени
+         * \param price_type Тип цены для бара, который еще не успел сформироваться
+         * \return Бар
+         */
+        inline CANDLE_TYPE find_timestamp_candle(
+                const uint32_t symbol_index,
+                const uint64_t timestamp,
+                const PriceType price_type) {
+            const uint64_t first_timestamp = (timestamp / SECONDS_IN_MINUTE) * SECONDS_IN_MINUTE;
+            const MtCandleStore<CANDLE_TYPE> &candles = array_candles[symbol_index];
+            if(candles.empty()) return CANDLE_TYPE();
+            /* особый случай, бар еще не успел сформироваться */
+            if(candles.back().timestamp == (first_timestamp - SECONDS_IN_MINUTE)) {
+                const MtTick tick = symbol_ticks[symbol_index].load();
+                const double price = price_type == PriceType::PRICE_BID_ASK_DIV2 ?
+                    (tick.bid + tick.ask) / 2.0 : price_type == PriceType::PRICE_ASK ?
+                    tick.ask : tick.bid;
+                return CANDLE_TYPE(price, price, price, price, 0, first_timestamp);
+            }
+            /* бары лежат на минутной сетке, ищем бар по индексу за O(1) */
+            const CANDLE_TYPE *candle = candles.find(first_timestamp);
+            if(candle == nullptr) return CANDLE_TYPE();
+            return *candle;
+        }
+
+        /** \brief Заполнить снимок баров всех символов
+         *
+         * Таблица имен символов снимка обновляется только при появлении новых символов,
+         * бары всех символов копируются под одной блокировкой
+         * \param snapshot Снимок
+         * \param timestamp Метка времени
+         * \param is_history Заполнить снимок готовыми барами истории. Иначе
+         * для бара, который еще не сформировался, будет подставлена цена последнего тика
+         */
+        void fill_snapshot(
+                MtSnapshot<CANDLE_TYPE> &snapshot,
+                const uint64_t timestamp,
+                const bool is_history) {
+            if(snapshot.size() != num_symbol) {
+                std::lock_guard<std::mutex> lock(symbol_list_mutex);
+                snapshot.set_symbol_names(symbol_list);
+            }
+            snapshot.set_timestamp(timestamp);
+            const uint64_t first_timestamp = (timestamp / SECONDS_IN_MINUTE) * SECONDS_IN_MINUTE;
+            std::lock_guard<std::mutex> lock(array_candles_mutex);
+            for(uint32_t symbol_index = 0; symbol_index < snapshot.size(); ++symbol_index) {
+                CANDLE_TYPE &candle = snapshot.at(symbol_index);
+                if(!is_history) {
+                    candle = find_timestamp_candle(symbol_index, timestamp, PriceType::PRICE_BID);
+                    continue;
+                }
+                const CANDLE_TYPE *history_candle = array_candles[symbol_index].find(first_timestamp);
+                if(history_candle != nullptr) {
+                    candle = *history_candle;
+                } else {
+                    candle = CANDLE_TYPE();
+                    candle.timestamp = first_timestamp;
+                }
+            }
+        }
+
+        /** \brief Заполнить снимок баров таймфрейма всех символов
+         *
+         * Если у символа нет такого таймфрейма или бара, в снимок попадает пустой бар
+         * \param snapshot Снимок
+         * \param timeframe Таймфрейм в минутах
+         * \param timestamp Метка времени начала бара таймфрейма
+         */
+        void fill_timeframe_snapshot(
+                MtSnapshot<CANDLE_TYPE> &snapshot,
+                const uint32_t timeframe,
+                const uint64_t timestamp) {
+            if(snapshot.size() != num_symbol) {
+                std::lock_guard<std::mutex> lock(symbol_list_mutex);
+                snapshot.set_symbol_names(symbol_list);
+            }
+            snapshot.set_timestamp(timestamp);
+            std::lock_guard<std::mutex> lock(array_candles_mutex);
+            for(uint32_t symbol_index = 0; symbol_index < snapshot.size(); ++symbol_index) {
+                CANDLE_TYPE &candle = snapshot.at(symbol_index);
+                const MtTimeframeAggregator<CANDLE_TYPE> *aggregator = find_timeframe(symbol_index, timeframe);
+                const CANDLE_TYPE *timeframe_candle = aggregator != nullptr ?
+                    aggregator->get_candles().find(timestamp) : nullptr;
+                if(timeframe_candle != nullptr) {
+                    candle = *timeframe_candle;
+                } else {
+                    candle = CANDLE_TYPE();
+                    candle.timestamp = timestamp;
+                }
+            }
+        }
+
+        /** \brief Передать закрытые бары старших таймфреймов
+         *
+         * Вызывается после события HISTORICAL_DATA_RECEIVED бара M1. Если этим
+         * баром закончился бар таймфрейма, снимок баров таймфрейма передается в timeframe_callback
+         * \param snapshot Снимок
+         * \param bar_timestamp Метка времени бара M1
+         */
+        void dispatch_timeframes(MtSnapshot<CANDLE_TYPE> &snapshot, const uint64_t bar_timestamp) {
+            if(config.timeframe_callback == nullptr) return;
+            const uint64_t end_timestamp = bar_timestamp + SECONDS_IN_MINUTE;
+            for(size_t i = 0; i < all_timeframes.size(); ++i) {
+                const uint64_t period = (uint64_t)all_timeframes[i] * SECONDS_IN_MINUTE;
+                if(end_timestamp % period != 0) continue;
+                fill_timeframe_snapshot(snapshot, all_timeframes[i], end_timestamp - period);
+                config.timeframe_callback(snapshot, all_timeframes[i],
+                    EventType::HISTORICAL_DATA_RECEIVED, end_timestamp - period);
+            }
+        }
+
+        /** \brief Заполнить матрицу исторических данных
+         * \param history Матрица исторических данных
+         * \param start_timestamp Метка времени первого бара
+         * \param number_bars Количество баров
+         */
+        void fill_history(
+                MtHistoryMatrix &history,
+                const uint64_t start_timestamp,
+                const uint32_t number_bars) {
+            {
+                std::lock_guard<std::mutex> lock(symbol_list_mutex);
+                history.reset(symbol_list, start_timestamp, number_bars);
+            }
+            std::lock_guard<std::mutex> lock(array_candles_mutex);
+            for(uint32_t symbol_index = 0; symbol_index < history.get_num_symbols(); ++symbol_index) {
+                const MtCandleStore<CANDLE_TYPE> &candles = array_candles[symbol_index];
+                for(uint32_t i = 0; i < number_bars; ++i) {
+                    const CANDLE_TYPE *candle = candles.find(history.get_timestamp(i));
+                    if(candle == nullptr) continue;
+                    history.set_candle(symbol_index, i, *candle);
+                }
+            }
+        }
+
+        /** \brief Передать снимок в функции обработки событий
+         *
+         * Для функции обработки событий с картой баров снимок преобразуется в карту
+         * \param snapshot Снимок
+         * \param event Событие
+         * \param timestamp Метка времени события
+         */
+        void dispatch_snapshot(
+                const MtSnapshot<CANDLE_TYPE> &snapshot,
+                const EventType event,
+                const uint64_t timestamp) {
+            if(config.snapshot_callback != nullptr) config.snapshot_callback(snapshot, event, timestamp);
+            if(config.callback == nullptr) return;
+            std::map<std::string, CANDLE_TYPE> candles;
+            for(uint32_t symbol_index = 0; symbol_index < snapshot.size(); ++symbol_index) {
+                candles[snapshot.get_symbol_name(symbol_index)] = snapshot[symbol_index];
+            }
+            config.callback(candles, event, timestamp);
+        }
+
+        /** \brief Обновить смещение метки времени
+         *
+         * Оценщик смещения получает кадры, в которых сменилась метка времени сервера,
+         * модель смещения публикуется для остальных потоков
+         * \param terminal Терминал
+         * \param server_timestamp Метка времени сервера из кадра
+         * \param pc_time Время компьютера в момент получения кадра
+         */
+        inline void update_offset_timestamp(Terminal &terminal, const uint64_t server_timestamp, const double pc_time) {
+            terminal.offset_estimator->update(server_timestamp, pc_time);
+            terminal.offset_model.store(terminal.offset_estimator->get_model());
         }
 
         /** \brief Обновить смещение метки времени из-за часового пояса
          *
+         * \param terminal Терминал
          * \param t смещение метки времени
          */
-        inline void update_offset_timezone(const uint64_t t) {
+        inline void update_offset_timezone(Terminal &terminal, const uint64_t t) {
             int64_t temp = (int64_t)((std::abs((double)get_timestamp() - (double)t) / 900.0d) + 0.5d) * 900;
-            offset_timezone = get_timestamp() > t ? temp : -temp;
-        }
-
-        inline uint64_t get_timestamp(
-            const uint32_t &day,
-            const uint32_t &month,
-            const uint32_t &year,
-            const uint32_t &hour,
-            const uint32_t &minute,
-            const uint32_t &second) {
-            uint64_t _secs;
-            long _mon, _year;
-            long long _days; // для предотвращения проблемы 2038 года переменная должна быть больше 32 бит
-            _mon = month - 1;
-            const long _TBIAS_YEAR = 1900;
-            const long long _DAYS_IN_YEAR = 365;
-            const long	lmos[] = {0, 31, 60, 91, 121, 152, 182, 213, 244, 274, 305, 335};
-            const long	mos[] = {0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334};
-            _year = year - _TBIAS_YEAR;
-            _days = (((_year - 1) / 4) + ((((_year) & 03) || ((_year) == 0)) ? mos[_mon] : lmos[_mon])) - 1;
-            _days += _DAYS_IN_YEAR * _year;
-            _days += day;
-            const long _TBIAS_DAYS = 25567;
-            const uint64_t _SECONDS_IN_MINUTE = 60;
-            const uint64_t _SECONDS_IN_HOUR = 3600;
-            const uint64_t _SECONDS_IN_DAY = 86400;
-            _days -= _TBIAS_DAYS;
-            _secs = _SECONDS_IN_HOUR * hour;
-            _secs += _SECONDS_IN_MINUTE * minute;
-            _secs += second;
-            _secs += _days * _SECONDS_IN_DAY;
-            return _secs;
+            terminal.offset_timezone = get_timestamp() > t ? temp : -temp;
+        }
+
+        /** \brief Проверить, есть ли данные для методов получения данных
+         * \return Вернет true, если терминал подключен или бары загружены методом load_candles
+         */
+        inline bool is_data_ready() const {
+            return is_mt_connected || is_candles_loaded;
+        }
+
+        /** \brief Получить основной терминал
+         *
+         * Основной терминал - первый подключенный терминал.
+         * Его время сервера используется для событий callback
+         * \return Терминал
+         */
+        inline Terminal &get_primary_terminal() {
+            for(size_t t = 0; t < terminals.size(); ++t) {
+                if(terminals[t]->is_connected) return *terminals[t];
+            }
+            return *terminals[0];
         }
 
         inline uint64_t get_timestamp() {
-            time_t rawtime;
-            time(&rawtime);
-            struct tm* ptm;
-            ptm = gmtime(&rawtime);
-            return get_timestamp(ptm->tm_mday, ptm->tm_mon + 1, ptm->tm_year + 1900, ptm->tm_hour, ptm->tm_min, ptm->tm_sec);
+            return clock->get_time_ns() / 1000000000ULL;
         }
 
         inline double get_ftimestamp() {
-            uint64_t t = get_timestamp();
-            timeb tb;
-            ftime(&tb);
-            return (double)t + (double)tb.millitm/1000.0;
+            return clock->get_time();
         }
 
     public:
@@ -271,50 +1522,52 @@ namespace mt_bridge {
          * \return смещение метки времени
          */
         inline double get_offset_timestamp() {
-            return offset_timestamp;
+            return get_primary_terminal().get_offset_timestamp(get_ftimestamp());
+        }
+
+        /** \brief Получить погрешность смещения метки времени
+         *
+         * Погрешность в пределах миллисекунд означает, что время сервера
+         * можно использовать для согласования событий смены секунды
+         * на разных компьютерах
+         * \return Оценка погрешности в секундах
+         */
+        inline double get_offset_uncertainty() {
+            return get_primary_terminal().offset_model.load().uncertainty;
         }
 
         /** \brief Получить время сервера с дробной частью в часовом поясе терминала
          * \return время сервера
          */
         inline double get_server_ftimestamp_with_timezone() {
-            return get_ftimestamp() + offset_timestamp;
+            const double pc_time = get_ftimestamp();
+            return pc_time + get_primary_terminal().get_offset_timestamp(pc_time);
         }
 
         /** \brief Получить время сервера с дробной частью
          * \return время сервера
          */
         inline double get_server_ftimestamp() {
-            return get_ftimestamp() + offset_timestamp + offset_timezone;
+            Terminal &terminal = get_primary_terminal();
+            const double pc_time = get_ftimestamp();
+            return pc_time + terminal.get_offset_timestamp(pc_time) + terminal.offset_timezone;
         }
 
         /** \brief Получить метку времени сервера MetaTrader
          * \return Метка времени сервера MetaTrader
          */
         inline uint64_t get_server_timestamp() {
-            return server_timestamp + offset_timezone;
+            Terminal &terminal = get_primary_terminal();
+            return terminal.server_timestamp + terminal.offset_timezone;
         }
 
         /** \brief Получить метку времени сервера MetaTrader
          * \return Метка времени сервера MetaTrader
          */
         inline uint64_t get_raw_server_timestamp() {
-            return server_timestamp;
+            return get_primary_terminal().server_timestamp;
         }
 
-        /// Типы События
-        enum class EventType {
-            NEW_TICK,                   /**< Получен новый тик */
-            HISTORICAL_DATA_RECEIVED,   /**< Получены исторические данные */
-        };
-
-        /// Типы цены
-        enum class PriceType {
-            PRICE_BID,          /**< Цена Bid */
-            PRICE_ASK,          /**< Цена Ask */
-            PRICE_BID_ASK_DIV2  /**< Цена (bid+ask)/2 */
-        };
-
         /** \brief Конструктор моста метатрейдера
          * \param port Номер порта
          * \param number_bars
@@ -323,268 +1576,253 @@ namespace mt_bridge {
         MetatraderBridge(
                 const uint32_t port,
                 const uint32_t number_bars = 1440,
-                std::function<void(
-                    const std::map<std::string, CANDLE_TYPE> &candles,
-                    const EventType event,
-                    const uint64_t timestamp)> callback = nullptr) {
+                Callback callback = nullptr) :
+                MetatraderBridge(Config(port, number_bars, callback)) {
+        }
+
+        /** \brief Конструктор моста метатрейдера
+         *
+         * Мост принимает соединения асинхронно. Если max_terminals больше 1,
+         * к одному мосту могут подключиться несколько терминалов, при этом
+         * имена символов получают префикс с именем терминала, например T1:EURUSD
+         * \param config Настройки моста
+         */
+        MetatraderBridge(const Config &bridge_config) :
+                config(bridge_config),
+                mt_acceptor(io_context) {
             is_mt_connected = false;
+            is_candles_loaded = false;
             is_error = false;
             is_stop_command = false;
+            is_tick_consumer_waiting = false;
+            bytes_processed = 0;
             num_symbol = 0;
-            mt_bridge_version = 0;
-            hist_init_len = 0;
-            server_timestamp = 0;
-            last_server_timestamp = 0;
-            offset_timestamp = 0;
-            offset_timezone = 0;
-
-            /* запустим соединение в отдельном потоке */
-            server_future = std::async(std::launch::async,[&, port]() {
-                while(!is_stop_command) {
-                    /* создадим соединение */
-                    std::shared_ptr<MtConnection> connection =
-                        std::make_shared<MtConnection>(port);
-                    /* очистим список символов */
-                    {
-                        std::lock_guard<std::mutex> lock(symbol_list_mutex);
-                        symbol_list.clear();
-                        symbol_name_to_index.clear();
-                    }
-                    /* очистим массивы символов */
-                    {
-                        std::lock_guard<std::mutex> lock(array_candles_mutex);
-                        array_candles.clear();
-                    }
-                    /* очищаем массивы для тиков */
-                    {
-                        std::lock_guard<std::mutex> lock(symbol_tick_mutex);
-                        symbol_bid.clear();
-                        symbol_ask.clear();
-                        symbol_timestamp.clear();
-                    }
-                    try {
-                        /* читаем версию эксперта для Metatrdaer */
-                        mt_bridge_version = connection->read_uint32();
-                        if(mt_bridge_version > MT_BRIDGE_MAX_VERSION)
-                            throw("Error! Unsupported expert version for metatrader");
-
-                        /* читаем количество символов */
-                        num_symbol = connection->read_uint32();
-                        if(num_symbol == 0)
-                            throw("Error! Invalid list of currency pairs!");
-
-                        /* инициализируем массивы тиковых данных */
-                        {
-                            std::lock_guard<std::mutex> lock(symbol_tick_mutex);
-                            symbol_bid.resize(num_symbol);
-                            symbol_ask.resize(num_symbol);
-                            symbol_timestamp.resize(num_symbol);
-                        }
+            symbol_tables.push_back(std::unique_ptr<MtSymbolTable>(new MtSymbolTable()));
+            symbol_table = symbol_tables.back().get();
+            last_callback_latency = 0;
+            max_callback_latency = 0;
+            sum_callback_latency = 0;
+            count_callback_latency = 0;
+            num_frames = 0;
+            num_connections = 0;
+            num_reconnects = 0;
+            num_resumes = 0;
+            num_callbacks = 0;
+
+            const uint32_t max_terminals = std::max(config.max_terminals, (uint32_t)1);
+            use_terminal_namespace = max_terminals > 1;
+            for(uint32_t t = 0; t < max_terminals; ++t) {
+                const std::string terminal_name = t < config.terminal_names.size() ?
+                    config.terminal_names[t] : ("T" + std::to_string(t));
+                std::unique_ptr<MtOffsetEstimator> estimator = config.offset_estimator != nullptr ?
+                    config.offset_estimator() : std::unique_ptr<MtOffsetEstimator>(new MtEdgeOffsetEstimator());
+                terminals.push_back(std::unique_ptr<Terminal>(new Terminal(terminal_name, std::move(estimator))));
+                if(t < config.terminal_names.size()) terminals.back()->terminal_id = terminal_name;
+            }
 
-                        /* инициализируем массив баров */
-                        {
-                            std::lock_guard<std::mutex> lock(array_candles_mutex);
-                            array_candles.resize(num_symbol);
-                        }
+            /* поток callback передает бары всех таймфреймов, которые есть хотя бы у одного символа */
+            all_timeframes = config.timeframes;
+            for(auto it = config.symbol_timeframes.begin(); it != config.symbol_timeframes.end(); ++it) {
+                all_timeframes.insert(all_timeframes.end(), it->second.begin(), it->second.end());
+            }
+            all_timeframes = normalize_timeframes(all_timeframes);
+            for(size_t i = 0; i < config.indicators.size(); ++i) {
+                indicators.add(config.indicators[i]);
+            }
 
-                        /* читаем имена символов */
-                        {
-                            std::lock_guard<std::mutex> lock(symbol_list_mutex);
-                            symbol_list.reserve(num_symbol);
-                            for(uint32_t s = 0; s < num_symbol; ++s) {
-                                symbol_list.push_back(connection->read_string());
-                                symbol_name_to_index[symbol_list.back()] = s;
-                            }
-                        }
+            if(!config.journal_path.empty() && !create_directory(config.journal_path)) {
+                std::cerr << "mt-bridge journal error: failed to create " << config.journal_path << std::endl;
+            }
+            if(!config.record_path.empty() && !create_directory(config.record_path)) {
+                std::cerr << "mt-bridge record error: failed to create " << config.record_path << std::endl;
+            }
+            if(!config.shm_name.empty()) {
+                shm_publisher = std::unique_ptr<MtShmPublisher>(new MtShmPublisher());
+                if(!shm_publisher->open(config.shm_name, config.shm_capacity, config.shm_max_symbols)) {
+                    std::cerr << "mt-bridge shm error: failed to create " << config.shm_name << std::endl;
+                    shm_publisher.reset();
+                }
+            }
+            if(config.rebroadcast_port != 0) {
+                try {
+                    rebroadcast_server.reset(new MtRebroadcastServer(
+                        io_context, config.rebroadcast_address, config.rebroadcast_port, config.rebroadcast_queue_size));
+                } catch (std::exception& e) {
+                    std::cerr << "mt-bridge rebroadcast error: " << e.what() << std::endl;
+                }
+            }
 
-                        /* читаем глубину истории для инициализации */
-                        hist_init_len = connection->read_uint32();
-                        uint64_t read_len = 0;
-                        while(!is_stop_command) {
-                            /* читаем данные символов */
-                            for(uint32_t s = 0; s < num_symbol; ++s) {
-                                const double bid = connection->read_double();
-                                const double ask = connection->read_double();
-                                const double open = connection->read_double();
-                                const double high = connection->read_double();
-                                const double low = connection->read_double();
-                                const double close = connection->read_double();
-
-                                const uint64_t volume = connection->read_uint64();
-                                uint64_t timestamp = connection->read_uint64();
-
-                                /* если смещение метки времени из-за часового пояса уже известно, учтем это смещение */
-                                if(read_len > 0) timestamp += offset_timezone;
-
-                                /* сохраняем тик */
-                                {
-                                    std::lock_guard<std::mutex> lock(symbol_tick_mutex);
-                                    symbol_bid[s] = bid;
-                                    symbol_ask[s] = ask;
-                                    symbol_timestamp[s] = timestamp;
-                                }
-
-                                /* сохраняем бар */
-                                {
-                                    std::lock_guard<std::mutex> lock(array_candles_mutex);
-                                    if(array_candles[s].size() == 0 || array_candles[s].back().timestamp < timestamp) {
-                                        array_candles[s].push_back(CANDLE_TYPE(open, high, low, close, volume, timestamp));
-                                    } else
-                                    if(array_candles[s].back().timestamp == timestamp) {
-                                        array_candles[s].back().open = open;
-                                        array_candles[s].back().high = high;
-                                        array_candles[s].back().low = low;
-                                        array_candles[s].back().close = close;
-                                        array_candles[s].back().volume = volume;
-                                        array_candles[s].back().timestamp = timestamp;
-                                    }
-                                }
-                            } // for s
-
-                            /* читаем метку времени сервера */
-                            server_timestamp = connection->read_uint64();
-
-                            /* если читаем данные в первый раз, обновим метку времени для всех баров */
-                            if(read_len == 0) {
-                                /* обновляем смещение метки времени из-за часового пояса */
-                                update_offset_timezone(server_timestamp);
-
-                                for(uint32_t s = 0; s < num_symbol; ++s) {
-                                    {
-                                        std::lock_guard<std::mutex> lock(symbol_tick_mutex);
-                                        symbol_timestamp[s] += offset_timezone;
-                                    }
-                                    std::lock_guard<std::mutex> lock(array_candles_mutex);
-                                    for(uint32_t i = 0; i < array_candles[s].size(); ++i) {
-                                        array_candles[s][i].timestamp += offset_timezone;
-                                    }
-                                }
-                            }
+            /* если время скачком переведено вперед, поток callback должен проверить таймер */
+            clock = config.clock ? config.clock : std::make_shared<MtSystemClock>();
+            clock->set_listener([this]() {
+                notify_all();
+            });
 
-                            /* если метка времени поменялась, найдем истинное время сервера */
-                            if(last_server_timestamp != server_timestamp) {
-                                last_server_timestamp = (uint64_t)server_timestamp;
-                                double pc_time = get_ftimestamp();
-                                double offset_time = (double)server_timestamp - pc_time;
-                                update_offset_timestamp(offset_time);
-                            }
+            /* запустим сервер в пуле потоков ввода-вывода */
+            start_server(config.port);
+            const uint32_t io_threads = std::max(config.io_threads, (uint32_t)1);
+            for(uint32_t i = 0; i < io_threads; ++i) {
+                server_futures.push_back(std::async(std::launch::async,[&]() {
+                    while(!is_stop_command) {
+                        try {
+                            io_context.run();
+                            break;
+                        } catch (std::exception& e) {
+                            std::cerr << "mt-bridge server error: " << e.what() << std::endl;
+                        } catch (...) {
+                            std::cerr << "mt-bridge server error" << std::endl;
+                        }
+                    }
+                }));
+            }
 
-                            ++read_len;
-                            if(read_len > hist_init_len) {
-                                /* теперь мы вправе сказать, что соединение удалось */
-                                is_error = false;
-                                is_mt_connected = true;
-                            }
-                        } // while
-                    } catch (std::exception& e) {
-                        std::cerr << "mt-bridge server error: " << e.what() << std::endl;
-                        is_mt_connected = false;
-                        is_error = true;
-                    } catch (...) {
-                        std::cerr << "mt-bridge server error" << std::endl;
-                        is_mt_connected = false;
-                        is_error = true;
+            /* создаем поток тиков */
+            if(config.tick_stream_capacity > 0 || config.tick_callback != nullptr) {
+                tick_queue.reset(new MtSpscQueue<MtRawTick>(
+                    std::max(config.tick_stream_capacity, (size_t)MT_BRIDGE_TICK_BATCH_SIZE)));
+                is_tick_producer_lock = io_threads > 1 && max_terminals > 1;
+            }
+            if(config.tick_callback != nullptr) {
+                tick_future = std::async(std::launch::async,[&]() {
+                    std::vector<MtRawTick> ticks(MT_BRIDGE_TICK_BATCH_SIZE);
+                    while(!is_stop_command) {
+                        if(!wait_ticks(1000)) continue;
+                        const size_t count = read_ticks(ticks.data(), ticks.size());
+                        for(size_t i = 0; i < count; ++i) {
+                            config.tick_callback(ticks[i], EventType::NEW_RAW_TICK, ticks[i].server_timestamp);
+                        }
                     }
-                    const uint32_t DELAY_WAIT = 1000;
-                    std::this_thread::sleep_for(std::chrono::milliseconds(DELAY_WAIT));
-                } // while
-            });
+                });
+            }
 
-            if(callback == nullptr) return;
+            const uint32_t number_bars = config.number_bars;
+            if(config.callback == nullptr &&
+                config.snapshot_callback == nullptr &&
+                config.history_callback == nullptr &&
+                config.timeframe_callback == nullptr &&
+                config.indicator_callback == nullptr) return;
 
             /* создаем поток обработки событий */
-            callback_future = std::async(std::launch::async,[&, number_bars, callback]() {
-                while(!is_mt_connected) {
-                    std::this_thread::yield();
-                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            const double fallback_delay = (double)config.callback_fallback_ms / 1000.0;
+            callback_future = std::async(std::launch::async,[&, number_bars, fallback_delay]() {
+                {
+                    std::unique_lock<std::mutex> lock(event_mutex);
+                    is_callback_waiting = true;
+                    event_cv.wait(lock, [&]() {
+                        return is_mt_connected || is_stop_command;
+                    });
+                    is_callback_waiting = false;
                     if(is_stop_command) return;
                 }
+                /* снимок баров выделяется один раз и переиспользуется для всех событий */
+                MtSnapshot<CANDLE_TYPE> snapshot;
+                MtSnapshot<CANDLE_TYPE> timeframe_snapshot;
+                MtIndicatorValues indicator_values;
+
                 /* сначала инициализируем исторические данные */
                 uint32_t hist_data_number_bars = number_bars;
                 while(!is_stop_command) {
                     const uint64_t init_date_timestamp =
-                        (((server_timestamp + offset_timezone) / SECONDS_IN_MINUTE) * SECONDS_IN_MINUTE) - SECONDS_IN_MINUTE;
-                    std::vector<std::map<std::string, CANDLE_TYPE>> hist_array_candles;
-                    init_historical_data(hist_array_candles, init_date_timestamp, hist_data_number_bars);
-                    /* далее отправляем загруженные данные в callback */
-                    uint64_t start_timestamp = init_date_timestamp - (hist_data_number_bars - 1) * SECONDS_IN_MINUTE;
-                    for(size_t i = 0; i < hist_array_candles.size(); ++i) {
-                        const uint64_t timestamp = i * SECONDS_IN_MINUTE + start_timestamp;
-                        if(callback != nullptr) callback(
-                            hist_array_candles[i],
-                            EventType::HISTORICAL_DATA_RECEIVED,
-                            timestamp);
+                        ((get_server_timestamp() / SECONDS_IN_MINUTE) * SECONDS_IN_MINUTE) - SECONDS_IN_MINUTE;
+                    const uint64_t start_timestamp = init_date_timestamp - (hist_data_number_bars - 1) * SECONDS_IN_MINUTE;
+                    if(config.history_callback != nullptr) {
+                        /* отправляем исторические данные одним вызовом */
+                        MtHistoryMatrix history;
+                        fill_history(history, start_timestamp, hist_data_number_bars);
+                        config.history_callback(history);
+                    } else {
+                        /* отправляем исторические данные в callback по одному бару */
+                        for(uint32_t i = 0; i < hist_data_number_bars; ++i) {
+                            const uint64_t timestamp = i * SECONDS_IN_MINUTE + start_timestamp;
+                            fill_snapshot(snapshot, timestamp, true);
+                            dispatch_snapshot(snapshot, EventType::HISTORICAL_DATA_RECEIVED, timestamp);
+                            dispatch_timeframes(timeframe_snapshot, timestamp);
+                        }
                     }
                     const uint64_t end_date_timestamp =
-                        (((server_timestamp + offset_timezone) / SECONDS_IN_MINUTE) * SECONDS_IN_MINUTE) -
+                        ((get_server_timestamp() / SECONDS_IN_MINUTE) * SECONDS_IN_MINUTE) -
                        SECONDS_IN_MINUTE;
                     if(end_date_timestamp == init_date_timestamp) break;
                     hist_data_number_bars = (end_date_timestamp - init_date_timestamp) / SECONDS_IN_MINUTE;
                 }
 
                 /* далее занимаемся получением новых тиков */
-                uint64_t last_timestamp = (uint64_t)get_server_ftimestamp();;
+                uint64_t last_timestamp = (uint64_t)get_server_ftimestamp();
                 uint64_t last_minute = last_timestamp / SECONDS_IN_MINUTE;
                 while(!is_stop_command) {
-                    uint64_t timestamp = (uint64_t)get_server_ftimestamp();;
-                    if(timestamp <= last_timestamp || !is_mt_connected) {
-                        std::this_thread::yield();
-                        std::this_thread::sleep_for(std::chrono::milliseconds(1));
-                        continue;
+                    /* ждем кадр с новой секундой сервера,
+                     * если кадра нет, вызываем callback по таймеру
+                     */
+                    uint64_t timestamp = 0;
+                    bool is_frame = false;
+                    std::chrono::steady_clock::time_point event_frame_time;
+                    {
+                        std::unique_lock<std::mutex> lock(event_mutex);
+                        while(!is_stop_command) {
+                            if(is_mt_connected && frame_server_timestamp > last_timestamp) {
+                                timestamp = frame_server_timestamp;
+                                event_frame_time = frame_time;
+                                is_frame = true;
+                                break;
+                            }
+                            const double server_time = get_server_ftimestamp();
+                            const double fallback_time = (double)(last_timestamp + 1) + fallback_delay;
+                            if(is_mt_connected && server_time >= fallback_time) {
+                                timestamp = (uint64_t)(server_time - fallback_delay);
+                                break;
+                            }
+                            const double delay = is_mt_connected ?
+                                std::min(std::max(fallback_time - server_time, 0.001), 1.0) : 1.0;
+                            is_callback_started = true;
+                            is_callback_waiting = true;
+                            callback_timestamp = last_timestamp;
+                            callback_fallback_time = fallback_time;
+                            event_cv.wait_for(lock, std::chrono::duration<double>(delay));
+                            is_callback_waiting = false;
+                        }
                     }
+                    if(is_stop_command) break;
+
                     /* начало новой секунды,
                      * собираем актуальные цены бара и вызываем callback
                      */
                     last_timestamp = timestamp;
-                    std::map<std::string, CANDLE_TYPE> candles;
-                    {
-                        std::lock_guard<std::mutex> lock(symbol_list_mutex);
-                        const uint64_t second = timestamp % SECONDS_IN_MINUTE;
-                        for(uint32_t symbol_index = 0;
-                            symbol_index < num_symbol;
-                            ++symbol_index) {
-                            std::string symbol_name(symbol_list[symbol_index]);
-                            if(second == 0) {
-                                candles[symbol_name] = get_timestamp_candle(symbol_index, timestamp - 1);
-                            } else {
-                                candles[symbol_name] = get_timestamp_candle(symbol_index, timestamp);
-                            }
-                        }
+                    const uint64_t second = timestamp % SECONDS_IN_MINUTE;
+                    fill_snapshot(snapshot, second == 0 ? timestamp - 1 : timestamp, false);
+                    if(config.indicator_callback != nullptr) {
+                        std::lock_guard<std::mutex> lock(array_candles_mutex);
+                        indicators.evaluate(indicator_values);
+                        indicator_values.set_timestamp(timestamp);
                     }
 
                     /* вызов callback */
-                    if(callback != nullptr) callback(candles, EventType::NEW_TICK, timestamp);
+                    const std::chrono::steady_clock::time_point callback_time = std::chrono::steady_clock::now();
+                    if(is_frame) {
+                        store_to_callback_histogram.record(event_frame_time, callback_time);
+                        add_callback_latency(std::chrono::duration<double>(callback_time - event_frame_time).count());
+                    }
+                    dispatch_snapshot(snapshot, EventType::NEW_TICK, timestamp);
+                    if(config.indicator_callback != nullptr) {
+                        config.indicator_callback(snapshot, indicator_values, EventType::NEW_TICK, timestamp);
+                    }
+                    callback_histogram.record(callback_time, std::chrono::steady_clock::now());
+                    ++num_callbacks;
 
                     /* загрузка исторических данных и повторный вызов callback,
                      * если нужно
                      */
                     uint64_t server_minute = timestamp / SECONDS_IN_MINUTE;
-                    if(server_minute <= last_minute) {
-                        std::this_thread::yield();
-                        std::this_thread::sleep_for(std::chrono::milliseconds(1));
-                        continue;
-                    }
+                    if(server_minute <= last_minute) continue;
                     hist_data_number_bars = server_minute - last_minute;
-                    const int64_t start_timestamp = last_minute * SECONDS_IN_MINUTE;
+                    const uint64_t start_timestamp = last_minute * SECONDS_IN_MINUTE;
                     last_minute = server_minute;
 
-                    /* загружаем исторические данные в несколько потоков */
-                    const uint64_t download_date_timestamp =
-                        ((timestamp / SECONDS_IN_MINUTE) * SECONDS_IN_MINUTE) -
-                        SECONDS_IN_MINUTE;
-
-                    std::vector<std::map<std::string, CANDLE_TYPE>> hist_array_candles;
-                    init_historical_data(
-                        hist_array_candles,
-                        download_date_timestamp,
-                        hist_data_number_bars);
-                    for(size_t i = 0; i < hist_array_candles.size(); ++i) {
-                        if(callback != nullptr) callback(
-                            hist_array_candles[i],
-                            EventType::HISTORICAL_DATA_RECEIVED,
-                            start_timestamp + i * SECONDS_IN_MINUTE);
+                    for(uint32_t i = 0; i < hist_data_number_bars; ++i) {
+                        const uint64_t bar_timestamp = start_timestamp + i * SECONDS_IN_MINUTE;
+                        fill_snapshot(snapshot, bar_timestamp, true);
+                        dispatch_snapshot(snapshot, EventType::HISTORICAL_DATA_RECEIVED, bar_timestamp);
+                        dispatch_timeframes(timeframe_snapshot, bar_timestamp);
                     }
-                    std::this_thread::yield();
                 } // while
             });
             //stream_thread.detach();
@@ -592,16 +1830,25 @@ namespace mt_bridge {
 
         ~MetatraderBridge() {
             is_stop_command = true;
-            /* Существует проблема с циклом yield().
-             * Если поток, вызывающий деструктор, имеет более высокий приоритет, чем завершаемый поток,
-             * то ваш проект может вечно жить в однопроцессорной системе.
-             * Даже в многоядерной системе может быть большая задержка.
-             * https://coderoad.ru/7927773
+            clock->set_listener(nullptr);
+            notify_all();
+            if(tick_queue) {
+                /* писатель не должен ждать читателя, которого больше нет */
+                tick_queue->close();
+                {
+                    std::lock_guard<std::mutex> lock(tick_mutex);
+                }
+                tick_cv.notify_all();
+            }
+            /* останавливаем пул потоков ввода-вывода, затем закрываем порт
+             * и соединения, чтобы остановка не зависела от терминалов
              */
-            if(server_future.valid()) {
+            io_context.stop();
+            for(size_t i = 0; i < server_futures.size(); ++i) {
+                if(!server_futures[i].valid()) continue;
                 try {
-                    server_future.wait();
-                    server_future.get();
+                    server_futures[i].wait();
+                    server_futures[i].get();
                 }
                 catch(const std::exception &e) {
                     std::cerr << "Error: ~MetatraderBridge(), what: " << e.what() << std::endl;
@@ -610,6 +1857,7 @@ namespace mt_bridge {
                     std::cerr << "Error: ~MetatraderBridge()" << std::endl;
                 }
             }
+            stop_server();
             if(callback_future.valid()) {
                 try {
                     callback_future.wait();
@@ -622,6 +1870,18 @@ namespace mt_bridge {
                     std::cerr << "Error: ~MetatraderBridge()" << std::endl;
                 }
             }
+            if(tick_future.valid()) {
+                try {
+                    tick_future.wait();
+                    tick_future.get();
+                }
+                catch(const std::exception &e) {
+                    std::cerr << "Error: ~MetatraderBridge(), what: " << e.what() << std::endl;
+                }
+                catch(...) {
+                    std::cerr << "Error: ~MetatraderBridge()" << std::endl;
+                }
+            }
         }
 
         /** \brief Проверить соединение
@@ -638,22 +1898,160 @@ namespace mt_bridge {
          * \return вернет true, если соединение есть, иначе произошла ошибка
          */
         inline bool wait(std::function<void(const uint64_t second)> callback = nullptr) {
-            uint64_t tick = 0;
-            const uint64_t WAIT_DELAY = 10;
-            const uint64_t MS_IN_SECOND = 1000;
-            while(!is_error && !is_mt_connected) {
-                std::this_thread::yield();
-                std::this_thread::sleep_for(std::chrono::milliseconds(WAIT_DELAY));
-                if(callback == nullptr) continue;
-                tick += WAIT_DELAY;
-                if((tick % MS_IN_SECOND) == 0) callback(tick / MS_IN_SECOND);
+            uint64_t second = 0;
+            std::unique_lock<std::mutex> lock(event_mutex);
+            auto is_ready = [&]() {
+                return is_error || is_mt_connected || is_stop_command;
+            };
+            while(!is_ready()) {
+                if(callback == nullptr) {
+                    event_cv.wait(lock, is_ready);
+                    break;
+                }
+                if(event_cv.wait_for(lock, std::chrono::seconds(1), is_ready)) break;
+                lock.unlock();
+                callback(++second);
+                lock.lock();
             }
             return is_mt_connected;
         }
 
+        /** \brief Получить задержку от декодирования кадра до вызова callback
+         * \return Задержка последнего вызова callback в секундах
+         */
+        inline double get_callback_latency() {
+            return last_callback_latency;
+        }
+
+        /** \brief Получить среднюю задержку от декодирования кадра до вызова callback
+         * \return Средняя задержка в секундах
+         */
+        inline double get_average_callback_latency() {
+            const uint64_t count = count_callback_latency;
+            if(count == 0) return 0.0;
+            return sum_callback_latency / (double)count;
+        }
+
+        /** \brief Получить максимальную задержку от декодирования кадра до вызова callback
+         * \return Максимальная задержка в секундах
+         */
+        inline double get_max_callback_latency() {
+            return max_callback_latency;
+        }
+
+        /** \brief Получить метрики моста
+         *
+         * Гистограммы задержек этапов прохождения кадра и счетчики
+         * собираются всегда, без блокировок. Метод можно вызывать из любого потока
+         * \return Снимок метрик
+         */
+        MtMetrics get_metrics() {
+            MtMetrics metrics;
+            metrics.frames = num_frames;
+            metrics.bytes = bytes_processed;
+            metrics.connections = num_connections;
+            metrics.reconnects = num_reconnects;
+            metrics.resumes = num_resumes;
+            metrics.callbacks = num_callbacks;
+            metrics.receive_to_decode = receive_to_decode_histogram.get_stats();
+            metrics.decode_to_store = decode_to_store_histogram.get_stats();
+            metrics.store_to_callback = store_to_callback_histogram.get_stats();
+            metrics.callback = callback_histogram.get_stats();
+            metrics.lock_wait = lock_wait_histogram.get_stats();
+            metrics.reconnect_gap = reconnect_gap_histogram.get_stats();
+            return metrics;
+        }
+
+        /** \brief Очистить гистограммы задержек
+         *
+         * Счетчики кадров, байтов и соединений не сбрасываются
+         */
+        void reset_metrics() {
+            receive_to_decode_histogram.reset();
+            decode_to_store_histogram.reset();
+            store_to_callback_histogram.reset();
+            callback_histogram.reset();
+            lock_wait_histogram.reset();
+            reconnect_gap_histogram.reset();
+        }
+
+        /** \brief Получить количество полученных и разобранных байтов
+         *
+         * Нужно, чтобы при воспроизведении записи (MtReplayer) переводить
+         * часы только после того, как мост разобрал предыдущий блок
+         * \return Количество байтов всех соединений
+         */
+        inline uint64_t get_bytes_processed() {
+            return bytes_processed;
+        }
+
+        /** \brief Проверить, обработал ли поток callback все события
+         *
+         * Нужно, чтобы при воспроизведении записи без пауз (MtReplayer)
+         * переводить часы только после того, как мост вызвал все callback,
+         * которые вызвал бы в реальном времени
+         * \return Вернет true, если поток callback ждет новое событие
+         */
+        bool is_idle() {
+            if(!callback_future.valid()) return true;
+            std::lock_guard<std::mutex> lock(event_mutex);
+            if(!is_callback_waiting) return false;
+            if(!is_callback_started) return !is_mt_connected;
+            if(!is_mt_connected) return true;
+            if(frame_server_timestamp > callback_timestamp) return false;
+            return get_server_ftimestamp() < callback_fallback_time;
+        }
+
+        /** \brief Прочитать тики из потока тиков
+         *
+         * Поток тиков нужно включить в настройках (tick_stream_capacity).
+         * Метод может вызывать только один поток одновременно. Если задана
+         * функция tick_callback, очередь читает поток моста, и этот метод вызывать нельзя
+         * \param ticks Массив для тиков
+         * \param max_count Размер массива
+         * \return Количество прочитанных тиков
+         */
+        inline size_t read_ticks(MtRawTick *ticks, const size_t max_count) {
+            if(!tick_queue) return 0;
+            return tick_queue->pop(ticks, max_count);
+        }
+
+        /** \brief Подождать тики в потоке тиков
+         * \param timeout_ms Максимальное время ожидания в миллисекундах
+         * \return Вернет true, если в очереди есть тики
+         */
+        bool wait_ticks(const uint32_t timeout_ms) {
+            if(!tick_queue) return false;
+            if(!tick_queue->empty()) return true;
+            std::unique_lock<std::mutex> lock(tick_mutex);
+            is_tick_consumer_waiting = true;
+            tick_cv.wait_for(lock, std::chrono::milliseconds(timeout_ms), [&]() {
+                return !tick_queue->empty() || is_stop_command;
+            });
+            is_tick_consumer_waiting = false;
+            return !tick_queue->empty();
+        }
+
+        /** \brief Получить количество тиков, потерянных из-за переполнения потока тиков
+         * \return Количество тиков
+         */
+        inline uint64_t get_dropped_ticks() {
+            if(!tick_queue) return 0;
+            return tick_queue->get_dropped();
+        }
+
+        /** \brief Получить, сколько раз поток чтения ждал читателя потока тиков
+         * \return Количество ожиданий (для MtTickOverflow::BLOCK)
+         */
+        inline uint64_t get_blocked_ticks() {
+            if(!tick_queue) return 0;
+            return tick_queue->get_blocked();
+        }
+
         inline bool update_server_timestamp() {
             if(!is_mt_connected) return false;
             static uint64_t last_server_timestamp = 0;
+            const uint64_t server_timestamp = get_raw_server_timestamp();
             if(server_timestamp != last_server_timestamp) {
                 last_server_timestamp = server_timestamp;
                 return true;
@@ -665,26 +2063,173 @@ namespace mt_bridge {
          * \return Версия MT-Bridge, начиная с 1. Если вернет 0, значит нет подключения
          */
         inline uint32_t get_mt_bridge_version() {
-            return mt_bridge_version;
+            return get_primary_terminal().mt_bridge_version;
+        }
+
+        /** \brief Получить количество слотов терминалов
+         * \return Количество слотов терминалов
+         */
+        inline uint32_t get_num_terminals() {
+            return terminals.size();
+        }
+
+        /** \brief Получить имя терминала
+         * \param terminal_index Индекс терминала
+         * \return Имя терминала, которое используется как префикс имен символов
+         */
+        inline std::string get_terminal_name(const uint32_t terminal_index) {
+            if(terminal_index >= terminals.size()) return std::string();
+            return terminals[terminal_index]->name;
+        }
+
+        /** \brief Проверить соединение терминала
+         * \param terminal_index Индекс терминала
+         * \return Вернет true, если соединение с терминалом установлено
+         */
+        inline bool connected(const uint32_t terminal_index) {
+            if(terminal_index >= terminals.size()) return false;
+            return terminals[terminal_index]->is_connected;
         }
 
         /** \brief Получить список имен символов/валютных пар
          * \return список имен символов/валютных пар
          */
         std::vector<std::string> get_symbol_list() {
-            if(!is_mt_connected) return std::vector<std::string>();
+            if(!is_data_ready()) return std::vector<std::string>();
             std::lock_guard<std::mutex> lock(symbol_list_mutex);
             return symbol_list;
         }
 
+        /** \brief Получить исторические данные
+         *
+         * Матрица заполняется барами всех символов, которые заканчиваются баром date_timestamp
+         * \param history Матрица исторических данных
+         * \param date_timestamp Метка времени последнего бара
+         * \param number_bars Количество баров
+         * \return Вернет true, если соединение установлено
+         */
+        bool get_history(
+                MtHistoryMatrix &history,
+                const uint64_t date_timestamp,
+                const uint32_t number_bars) {
+            if(!is_data_ready() || number_bars == 0) return false;
+            const uint64_t end_timestamp = (date_timestamp / SECONDS_IN_MINUTE) * SECONDS_IN_MINUTE;
+            fill_history(history, end_timestamp - (number_bars - 1) * SECONDS_IN_MINUTE, number_bars);
+            return true;
+        }
+
+        /** \brief Получить индекс символа
+         *
+         * Индекс символа не меняется при переподключении терминала
+         * и совпадает с индексом символа в снимке MtSnapshot
+         * \param symbol_name Имя символа
+         * \return Индекс символа или -1, если символа нет
+         */
+        int32_t get_symbol_index(const std::string &symbol_name) {
+            const MtSymbolHandle handle = find_symbol(symbol_name);
+            return handle.is_valid() ? (int32_t)handle.index : -1;
+        }
+
+        /** \brief Получить дескриптор символа
+         *
+         * Поиск идет по неизменяемой таблице имен без блокировки. Дескриптор
+         * не меняется при переподключении терминала, поэтому его достаточно
+         * получить один раз и дальше обращаться к данным символа без поиска имени
+         * \param symbol_name Имя символа
+         * \return Дескриптор символа, is_valid() вернет false, если символа нет
+         */
+        inline SymbolHandle get_symbol_handle(const std::string &symbol_name) const {
+            return find_symbol(symbol_name);
+        }
+
+        /** \brief Загрузить бары символа без терминала
+         *
+         * Метод нужен только для замеров и проверки стратегий на готовых
+         * барах, поэтому работает, если задан Config::is_load_candles.
+         * Символ регистрируется так же, как при подключении терминала,
+         * цена последнего тика берется из последнего бара. Символы терминалов
+         * загрузить нельзя: тик символа пишет только один поток.
+         * Состояние соединения не меняется, но методы получения данных
+         * возвращают загруженные бары. Вызывать из одного потока
+         * \param symbol_name Имя символа
+         * \param candles Бары по возрастанию метки времени
+         * \return Индекс символа или -1, если загрузка запрещена или символ принадлежит терминалу
+         */
+        int32_t load_candles(const std::string &symbol_name, const std::vector<CANDLE_TYPE> &candles) {
+            if(!config.is_load_candles) return -1;
+            {
+                std::lock_guard<std::mutex> lock(symbol_list_mutex);
+                auto it = symbol_name_to_index.find(symbol_name);
+                if(it != symbol_name_to_index.end() && terminal_symbols[it->second]) return -1;
+            }
+            const uint32_t symbol_index = register_symbol(symbol_name, false);
+            publish_symbol_table();
+            {
+                std::lock_guard<std::mutex> lock(array_candles_mutex);
+                for(size_t i = 0; i < candles.size(); ++i) {
+                    array_candles[symbol_index].update(candles[i], [&](const CANDLE_TYPE &spilled_candle) {
+                        if(config.spill_callback != nullptr) config.spill_callback(symbol_index, spilled_candle);
+                    });
+                    update_aggregates(symbol_index, candles[i]);
+                }
+                if((shm_publisher || rebroadcast_server) && !candles.empty()) {
+                    const CANDLE_TYPE &candle = candles.back();
+                    publish_update(symbol_index, candle.close, candle.close, candle.timestamp, candle);
+                }
+            }
+            if(!candles.empty()) {
+                const CANDLE_TYPE &candle = candles.back();
+                symbol_ticks[symbol_index].store(MtTick(candle.close, candle.close, candle.timestamp));
+            }
+            is_candles_loaded = true;
+            return symbol_index;
+        }
+
+        /** \brief Получить тик символа по дескриптору
+         * \param handle Дескриптор символа
+         * \return Тик (bid, ask и метка времени)
+         */
+        inline MtTick get_tick(const SymbolHandle &handle) {
+            return get_tick(handle.index);
+        }
+
+        /** \brief Получить бар по дескриптору символа
+         * \param handle Дескриптор символа
+         * \param offset Смещение относительно последнего бара
+         * \return Бар
+         */
+        inline CANDLE_TYPE get_candle(const SymbolHandle &handle, const uint32_t offset = 0) {
+            return get_candle(handle.index, offset);
+        }
+
+        /** \brief Получить массив баров по дескриптору символа
+         * \param handle Дескриптор символа
+         * \return Массив баров
+         */
+        inline std::vector<CANDLE_TYPE> get_candles(const SymbolHandle &handle) {
+            return get_candles(handle.index);
+        }
+
+        /** \brief Получить бар по дескриптору символа и метке времени
+         * \param handle Дескриптор символа
+         * \param timestamp Метка времени
+         * \param price_type Тип цены
+         * \return Бар
+         */
+        inline CANDLE_TYPE get_timestamp_candle(
+                const SymbolHandle &handle,
+                const uint64_t timestamp,
+                const PriceType price_type = PriceType::PRICE_BID) {
+            return get_timestamp_candle(handle.index, timestamp, price_type);
+        }
+
         /** \brief Получить цену bid символа
          * \param symbol_index Индекс символа
          * \return Цена bid
          */
         inline double get_bid(const uint32_t symbol_index) {
-            if(!is_mt_connected || symbol_index >= num_symbol) return 0.0;
-            std::lock_guard<std::mutex> lock(symbol_tick_mutex);
-            return symbol_bid[symbol_index];
+            if(!is_data_ready() || symbol_index >= num_symbol) return 0.0;
+            return symbol_ticks[symbol_index].load().bid;
         }
 
         /** \brief Получить цену ask символа
@@ -692,9 +2237,19 @@ namespace mt_bridge {
          * \return Цена ask
          */
         inline double get_ask(const uint32_t symbol_index) {
-            if(!is_mt_connected || symbol_index >= num_symbol) return 0.0;
-            std::lock_guard<std::mutex> lock(symbol_tick_mutex);
-            return symbol_ask[symbol_index];
+            if(!is_data_ready() || symbol_index >= num_symbol) return 0.0;
+            return symbol_ticks[symbol_index].load().ask;
+        }
+
+        /** \brief Получить тик символа
+         *
+         * Метод не блокирует поток и всегда возвращает согласованные bid и ask
+         * \param symbol_index Индекс символа
+         * \return Тик (bid, ask и метка времени)
+         */
+        inline MtTick get_tick(const uint32_t symbol_index) {
+            if(!is_data_ready() || symbol_index >= num_symbol) return MtTick();
+            return symbol_ticks[symbol_index].load();
         }
 
         /** \brief Получить бар
@@ -703,7 +2258,7 @@ namespace mt_bridge {
          * \return Бар
          */
         inline CANDLE_TYPE get_candle(const uint32_t symbol_index, const uint32_t offset = 0) {
-            if(!is_mt_connected || symbol_index >= num_symbol) return CANDLE_TYPE();
+            if(!is_data_ready() || symbol_index >= num_symbol) return CANDLE_TYPE();
             std::lock_guard<std::mutex> lock(array_candles_mutex);
             const size_t array_size = array_candles[symbol_index].size();
             if(offset >= array_size) return CANDLE_TYPE();
@@ -716,14 +2271,10 @@ namespace mt_bridge {
          * \return Бар
          */
         inline CANDLE_TYPE get_candle(const std::string &symbol_name) {
-            if(!is_mt_connected) return CANDLE_TYPE();
-            uint32_t symbol_index;
-            {
-                std::lock_guard<std::mutex> lock(symbol_list_mutex);
-                auto it = symbol_name_to_index.find(symbol_name);
-                if(it == symbol_name_to_index.end()) return CANDLE_TYPE();
-                symbol_index = it->second;
-            }
+            if(!is_data_ready()) return CANDLE_TYPE();
+            const MtSymbolHandle handle = find_symbol(symbol_name);
+            if(!handle.is_valid()) return CANDLE_TYPE();
+            const uint32_t symbol_index = handle.index;
             return get_candle(symbol_index);
         }
 
@@ -732,9 +2283,9 @@ namespace mt_bridge {
          * \return Массив баров
          */
         inline std::vector<CANDLE_TYPE> get_candles(const uint32_t symbol_index) {
-            if(!is_mt_connected || symbol_index >= num_symbol) return  std::vector<CANDLE_TYPE>();
+            if(!is_data_ready() || symbol_index >= num_symbol) return  std::vector<CANDLE_TYPE>();
             std::lock_guard<std::mutex> lock(array_candles_mutex);
-            return array_candles[symbol_index];
+            return array_candles[symbol_index].get_candles();
         }
 
 
@@ -743,14 +2294,10 @@ namespace mt_bridge {
          * \return Массив баров
          */
         inline std::vector<CANDLE_TYPE> get_candles(const std::string &symbol_name) {
-            if(!is_mt_connected) return  std::vector<CANDLE_TYPE>();
-            uint32_t symbol_index;
-            {
-                std::lock_guard<std::mutex> lock(symbol_list_mutex);
-                auto it = symbol_name_to_index.find(symbol_name);
-                if(it == symbol_name_to_index.end()) return CANDLE_TYPE();
-                symbol_index = it->second;
-            }
+            if(!is_data_ready()) return  std::vector<CANDLE_TYPE>();
+            const MtSymbolHandle handle = find_symbol(symbol_name);
+            if(!handle.is_valid()) return std::vector<CANDLE_TYPE>();
+            const uint32_t symbol_index = handle.index;
             return get_candles(symbol_index);
         }
 
@@ -765,37 +2312,9 @@ namespace mt_bridge {
                 const uint32_t symbol_index,
                 const uint64_t timestamp,
                 const PriceType price_type = PriceType::PRICE_BID) {
-            if(!is_mt_connected || symbol_index >= num_symbol) return CANDLE_TYPE();
-            const uint64_t first_timestamp = (timestamp / SECONDS_IN_MINUTE) * SECONDS_IN_MINUTE;
+            if(!is_data_ready() || symbol_index >= num_symbol) return CANDLE_TYPE();
             std::lock_guard<std::mutex> lock(array_candles_mutex);
-
-            const size_t array_candles_size =
-                array_candles[symbol_index].size();
-            if(array_candles_size == 0) return CANDLE_TYPE();
-            /* особый случай, бар еще не успел сформироваться */
-            if(array_candles[symbol_index].back().timestamp == (first_timestamp - SECONDS_IN_MINUTE)) {
-                double price = 0;
-                {
-                    std::lock_guard<std::mutex> lock2(symbol_tick_mutex);
-                    const double ask = symbol_ask[symbol_index];
-                    const double bid = symbol_bid[symbol_index];
-                    price = price_type == PriceType::PRICE_BID_ASK_DIV2 ?
-                        (bid + ask) /2.0 : price_type == PriceType::PRICE_BID ?
-                        bid : price_type == PriceType::PRICE_ASK ?
-                        ask : bid;
-                }
-                return CANDLE_TYPE(price, price, price, price,
-                    0, first_timestamp);
-            }
-            int64_t index = array_candles_size - 1;
-            while(true) {
-                if(array_candles[symbol_index][index].timestamp == first_timestamp) {
-                    return array_candles[symbol_index][index];
-                }
-                if(index > 0) --index;
-                else break;
-            }
-            return CANDLE_TYPE();
+            return find_timestamp_candle(symbol_index, timestamp, price_type);
         }
 
 
@@ -810,17 +2329,104 @@ namespace mt_bridge {
                 const std::string &symbol_name,
                 const uint64_t timestamp,
                 const PriceType price_type = PriceType::PRICE_BID) {
-            if(!is_mt_connected) return CANDLE_TYPE();
-            uint32_t symbol_index;
-            {
-                std::lock_guard<std::mutex> lock(symbol_list_mutex);
-                auto it = symbol_name_to_index.find(symbol_name);
-                if(it == symbol_name_to_index.end()) return CANDLE_TYPE();
-                symbol_index = it->second;
-            }
+            if(!is_data_ready()) return CANDLE_TYPE();
+            const MtSymbolHandle handle = find_symbol(symbol_name);
+            if(!handle.is_valid()) return CANDLE_TYPE();
+            const uint32_t symbol_index = handle.index;
             return get_timestamp_candle(symbol_index, timestamp, price_type);
         }
 
+        /** \brief Получить старшие таймфреймы символа
+         * \param symbol_index Индекс символа
+         * \return Таймфреймы в минутах по возрастанию
+         */
+        std::vector<uint32_t> get_timeframes(const uint32_t symbol_index) {
+            std::vector<uint32_t> timeframes;
+            if(symbol_index >= num_symbol) return timeframes;
+            std::lock_guard<std::mutex> lock(array_candles_mutex);
+            for(size_t i = 0; i < array_timeframes[symbol_index].size(); ++i) {
+                timeframes.push_back(array_timeframes[symbol_index][i].get_timeframe());
+            }
+            return timeframes;
+        }
+
+        /** \brief Получить бар старшего таймфрейма
+         * \param symbol_index Индекс символа
+         * \param timeframe Таймфрейм в минутах
+         * \param offset Смещение относительно последнего бара
+         * \return Бар или пустой бар, если у символа нет такого таймфрейма
+         */
+        inline CANDLE_TYPE get_timeframe_candle(
+                const uint32_t symbol_index,
+                const uint32_t timeframe,
+                const uint32_t offset = 0) {
+            if(!is_data_ready() || symbol_index >= num_symbol) return CANDLE_TYPE();
+            std::lock_guard<std::mutex> lock(array_candles_mutex);
+            const MtTimeframeAggregator<CANDLE_TYPE> *aggregator = find_timeframe(symbol_index, timeframe);
+            if(aggregator == nullptr) return CANDLE_TYPE();
+            const MtCandleStore<CANDLE_TYPE> &candles = aggregator->get_candles();
+            if(offset >= candles.size()) return CANDLE_TYPE();
+            return candles[candles.size() - offset - 1];
+        }
+
+        /** \brief Получить массив баров старшего таймфрейма
+         * \param symbol_index Индекс символа
+         * \param timeframe Таймфрейм в минутах
+         * \return Массив баров
+         */
+        inline std::vector<CANDLE_TYPE> get_timeframe_candles(
+                const uint32_t symbol_index,
+                const uint32_t timeframe) {
+            if(!is_data_ready() || symbol_index >= num_symbol) return std::vector<CANDLE_TYPE>();
+            std::lock_guard<std::mutex> lock(array_candles_mutex);
+            const MtTimeframeAggregator<CANDLE_TYPE> *aggregator = find_timeframe(symbol_index, timeframe);
+            if(aggregator == nullptr) return std::vector<CANDLE_TYPE>();
+            return aggregator->get_candles().get_candles();
+        }
+
+        /** \brief Получить бар старшего таймфрейма по метке времени
+         *
+         * Поиск бара выполняется за O(1), как и для баров M1
+         * \param symbol_index Индекс символа
+         * \param timeframe Таймфрейм в минутах
+         * \param timestamp Метка времени любой секунды внутри бара таймфрейма
+         * \return Бар или пустой бар, если бара нет
+         */
+        inline CANDLE_TYPE get_timeframe_timestamp_candle(
+                const uint32_t symbol_index,
+                const uint32_t timeframe,
+                const uint64_t timestamp) {
+            if(!is_data_ready() || symbol_index >= num_symbol) return CANDLE_TYPE();
+            std::lock_guard<std::mutex> lock(array_candles_mutex);
+            const MtTimeframeAggregator<CANDLE_TYPE> *aggregator = find_timeframe(symbol_index, timeframe);
+            if(aggregator == nullptr) return CANDLE_TYPE();
+            const CANDLE_TYPE *candle = aggregator->get_candles().find(timestamp);
+            if(candle == nullptr) return CANDLE_TYPE();
+            return *candle;
+        }
+
+        /** \brief Получить счетчики подписчиков ретрансляции
+         * \return Счетчики подключенных подписчиков
+         */
+        std::vector<MtRebroadcastStats> get_rebroadcast_stats() {
+            if(!rebroadcast_server) return std::vector<MtRebroadcastStats>();
+            return rebroadcast_server->get_stats();
+        }
+
+        /** \brief Получить значения индикаторов всех символов
+         *
+         * Значения считаются по последним барам M1, несформированный бар
+         * учитывается с текущими ценами. Номера индикаторов совпадают
+         * с порядком в Config::indicators, выделение памяти нужно только
+         * при первом вызове и при появлении новых символов
+         * \param values Значения индикаторов
+         */
+        void get_indicator_values(MtIndicatorValues &values) {
+            std::lock_guard<std::mutex> lock(array_candles_mutex);
+            indicators.evaluate(values);
+            values.set_timestamp(get_server_timestamp());
+        }
+
         /** \brief Получить бар по имени
          * \param symbol_name Имя валютной пары
          * \param candles Карта баров валютных пар
@@ -835,6 +2441,22 @@ namespace mt_bridge {
             return it->second;
         }
 
+        /** \brief Получить бар из снимка по дескриптору символа
+         *
+         * В отличие от поиска в карте баров, поиска имени нет
+         * \param handle Дескриптор символа
+         * \param snapshot Снимок баров
+         * \return Бар
+         */
+        inline const static CANDLE_TYPE get_candle(
+                const SymbolHandle &handle,
+                const MtSnapshot<CANDLE_TYPE> &snapshot) {
+            if(handle.index >= snapshot.size()) return CANDLE_TYPE();
+            const CANDLE_TYPE &candle = snapshot[handle.index];
+            if(candle.close == 0 || candle.timestamp == 0) return CANDLE_TYPE();
+            return candle;
+        }
+
         /** \brief Проверить бар
          * \param candle Бар
          * \return Вернет true, если данные по бару корректны